@@ -3,6 +3,7 @@
 
 #include <QVulkanInstance>
 #include "VulkanFunctions.hpp"
+#include "MemoryAllocator.hpp"
 
 class Buffer {
 public:
@@ -10,31 +11,39 @@ public:
     public:
         VkDeviceSize size;
         VkBufferUsageFlags usage;
-        VkMemoryPropertyFlags memory_properties;
+        VkMemoryPropertyFlags memory_properties; // Required
 
         VkSharingMode sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
         VkBufferCreateFlags create_flags = 0;
+        // Used if available, e.g. DEVICE_LOCAL for host-visible buffers the device reads every frame (resizable BAR),
+        // HOST_CACHED for buffers the host reads back
+        VkMemoryPropertyFlags preferred_memory_properties = 0;
     };
 
     VkResult create(VulkanData vkd, const CreateData& bcd);
     void destroy();
 
-    // Creates a host-mappable staging buffer, maps the data into the staging buffer, then copys the data from the staging buffer into the buffer
-    // Returns the created staging buffer. It Should be destroyed after the queue is submitted (it will not be automatically destroyed)
-    // No synchronization is done
-    static Buffer copy_data_to_buffer(VulkanData vkd, VkBuffer buffer, const void* data, VkDeviceSize size, VkCommandBuffer command_buffer);
-    Buffer copy_data_to_buffer(const void* data, VkDeviceSize size, VkCommandBuffer command_buffer);
+    // Only needed if the memory isn't coherent: call `flush` after writing to the mapped memory & before the device reads it,
+    // `invalidate` after the device has written to it & before reading the mapped memory
+    VkResult flush(VkDeviceSize offset=0, VkDeviceSize size=VK_WHOLE_SIZE);
+    VkResult invalidate(VkDeviceSize offset=0, VkDeviceSize size=VK_WHOLE_SIZE);
 
 
     // Getters
 
     VkBuffer get_vk_buffer() {return buffer;}
-    VkDeviceMemory get_vk_buffer_memory() {return buffer_memory;}
+    VkDeviceMemory get_vk_buffer_memory() {return allocation.memory;}
+    // Offset of the buffer inside `get_vk_buffer_memory()`
+    VkDeviceSize get_memory_offset() {return allocation.offset;}
+    // Persistently mapped pointer to the buffer's memory (nullptr if the memory isn't host-visible)
+    void* get_mapped_memory() {return allocation.mapped;}
+    // Properties of the memory type the buffer ended up in (a superset of the required properties)
+    VkMemoryPropertyFlags get_memory_properties() {return allocation.memory_properties;}
     CreateData get_create_data() {return bcd;}
 
 private:
     VkBuffer buffer = VK_NULL_HANDLE;
-    VkDeviceMemory buffer_memory = VK_NULL_HANDLE;
+    MemoryAllocator::Allocation allocation{};
 
     VulkanData vkd{};
     CreateData bcd{};
@@ -0,0 +1,125 @@
+#include "DescriptorAllocator.hpp"
+
+#include <QVulkanDeviceFunctions>
+#include <QDebug>
+
+#include <algorithm>
+
+namespace {
+    // Descriptors of each type per set. Pools are sized for the average set, not the largest
+    struct PoolSizeRatio {
+        VkDescriptorType type;
+        float ratio;
+    };
+    const PoolSizeRatio pool_size_ratios[] = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+    };
+
+    const uint32_t max_pool_sets = 4096;
+}
+
+VkResult DescriptorAllocator::create(VulkanData vkd, uint32_t initial_sets) {
+    this->vkd = vkd;
+    next_pool_sets = std::max(initial_sets, 1u);
+    nr_allocated_sets = 0;
+    return next_pool();
+}
+
+void DescriptorAllocator::destroy() {
+    if (current_pool != VK_NULL_HANDLE)
+        used_pools.push_back(current_pool);
+    current_pool = VK_NULL_HANDLE;
+    for (VkDescriptorPool pool : used_pools)
+        vkd.vkdf->vkDestroyDescriptorPool(vkd.device, pool, nullptr);
+    for (VkDescriptorPool pool : free_pools)
+        vkd.vkdf->vkDestroyDescriptorPool(vkd.device, pool, nullptr);
+    used_pools.clear();
+    free_pools.clear();
+    nr_allocated_sets = 0;
+}
+
+VkResult DescriptorAllocator::allocate(VkDescriptorSetLayout layout, VkDescriptorSet& set) {
+    VkDescriptorSetAllocateInfo allocation_info{};
+    allocation_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocation_info.descriptorSetCount = 1;
+    allocation_info.pSetLayouts = &layout;
+
+    VkResult res = VK_ERROR_OUT_OF_POOL_MEMORY;
+    if (current_pool != VK_NULL_HANDLE) {
+        allocation_info.descriptorPool = current_pool;
+        res = vkd.vkdf->vkAllocateDescriptorSets(vkd.device, &allocation_info, &set);
+    }
+
+    if (res == VK_ERROR_OUT_OF_POOL_MEMORY || res == VK_ERROR_FRAGMENTED_POOL) {
+        if (current_pool != VK_NULL_HANDLE)
+            used_pools.push_back(current_pool);
+        current_pool = VK_NULL_HANDLE;
+
+        res = next_pool();
+        if (res != VK_SUCCESS)
+            return res;
+
+        // A fresh pool only fails if the layout needs more descriptors than a whole pool holds
+        allocation_info.descriptorPool = current_pool;
+        res = vkd.vkdf->vkAllocateDescriptorSets(vkd.device, &allocation_info, &set);
+    }
+
+    if (res != VK_SUCCESS) {
+        qWarning("DescriptorAllocator: Failed to allocate descriptor set: %d", res);
+        return res;
+    }
+    nr_allocated_sets++;
+    return VK_SUCCESS;
+}
+
+void DescriptorAllocator::reset() {
+    if (current_pool != VK_NULL_HANDLE)
+        used_pools.push_back(current_pool);
+    current_pool = VK_NULL_HANDLE;
+
+    for (VkDescriptorPool pool : used_pools) {
+        VkResult res = vkd.vkdf->vkResetDescriptorPool(vkd.device, pool, 0);
+        if (res != VK_SUCCESS)
+            qWarning("DescriptorAllocator: Failed to reset descriptor pool: %d", res);
+        free_pools.push_back(pool);
+    }
+    used_pools.clear();
+    nr_allocated_sets = 0;
+}
+
+VkResult DescriptorAllocator::next_pool() {
+    if (!free_pools.empty()) {
+        current_pool = free_pools.back();
+        free_pools.pop_back();
+        return VK_SUCCESS;
+    }
+
+    VkResult res = create_pool(next_pool_sets, current_pool);
+    if (res != VK_SUCCESS) {
+        qWarning("DescriptorAllocator: Failed to create descriptor pool: %d", res);
+        current_pool = VK_NULL_HANDLE;
+        return res;
+    }
+    next_pool_sets = std::min(next_pool_sets * 2, max_pool_sets);
+    return VK_SUCCESS;
+}
+
+VkResult DescriptorAllocator::create_pool(uint32_t max_sets, VkDescriptorPool& pool) {
+    VkDescriptorPoolSize pool_sizes[sizeof(pool_size_ratios)/sizeof(pool_size_ratios[0])];
+    for (size_t i=0; i<sizeof(pool_size_ratios)/sizeof(pool_size_ratios[0]); i++) {
+        pool_sizes[i].type = pool_size_ratios[i].type;
+        pool_sizes[i].descriptorCount = std::max(uint32_t(pool_size_ratios[i].ratio * max_sets), 1u);
+    }
+
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = max_sets;
+    pool_info.poolSizeCount = sizeof(pool_sizes)/sizeof(pool_sizes[0]);
+    pool_info.pPoolSizes = pool_sizes;
+
+    return vkd.vkdf->vkCreateDescriptorPool(vkd.device, &pool_info, nullptr, &pool);
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef DESCRIPTOR_ALLOCATOR_HPP
+#define DESCRIPTOR_ALLOCATOR_HPP
+
+#include <QVulkanInstance>
+
+#include <vector>
+
+#include "VulkanFunctions.hpp"
+
+// Allocates descriptor sets of any layout from a chain of pools. When the current pool runs out
+// (VK_ERROR_OUT_OF_POOL_MEMORY/VK_ERROR_FRAGMENTED_POOL) allocation continues in a free pool or a new one twice as large
+// Sets aren't freed individually: `reset` returns all of them to their pools at once, after which every pool is reused
+// Warning: `destroy` will not be called on destructor. It must explicitly be called after `create`
+class DescriptorAllocator {
+public:
+    // `initial_sets` is the number of sets the first pool is sized for
+    VkResult create(VulkanData vkd, uint32_t initial_sets = 64);
+    void destroy();
+
+    VkResult allocate(VkDescriptorSetLayout layout, VkDescriptorSet& set);
+    // None of the allocated sets may be in use anymore (e.g. the fence of the frame that used them has signaled)
+    void reset();
+
+
+    // Getters
+
+    uint32_t get_nr_pools() {return used_pools.size() + free_pools.size() + (current_pool != VK_NULL_HANDLE ? 1 : 0);}
+    uint32_t get_nr_allocated_sets() {return nr_allocated_sets;}
+
+private:
+    VulkanData vkd{};
+
+    // Takes a free pool or creates a new one
+    VkResult next_pool();
+    VkResult create_pool(uint32_t max_sets, VkDescriptorPool& pool);
+
+    VkDescriptorPool current_pool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool> used_pools; // Exhausted, until `reset`
+    std::vector<VkDescriptorPool> free_pools;
+    uint32_t next_pool_sets = 0;
+    uint32_t nr_allocated_sets = 0;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "DescriptorCache.hpp"
+
+#include <QVulkanDeviceFunctions>
+#include <QDebug>
+
+#include <functional>
+
+namespace {
+    template<typename T>
+    inline void hash_combine(size_t& seed, const T& value) {
+        seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+
+    bool is_image_type(VkDescriptorType type) {
+        return type == VK_DESCRIPTOR_TYPE_SAMPLER || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+               type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE || type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    }
+}
+
+DescriptorCache::Binding DescriptorCache::Binding::buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    Binding result;
+    result.binding = binding;
+    result.type = type;
+    result.buffer_info = VkDescriptorBufferInfo{buffer, offset, range};
+    return result;
+}
+
+DescriptorCache::Binding DescriptorCache::Binding::image(uint32_t binding, VkDescriptorType type, VkImageView image_view, VkSampler sampler, VkImageLayout layout) {
+    Binding result;
+    result.binding = binding;
+    result.type = type;
+    result.image_info = VkDescriptorImageInfo{sampler, image_view, layout};
+    return result;
+}
+
+bool DescriptorCache::Binding::operator==(const Binding& other) const {
+    return binding == other.binding && type == other.type &&
+           buffer_info.buffer == other.buffer_info.buffer && buffer_info.offset == other.buffer_info.offset &&
+           buffer_info.range == other.buffer_info.range &&
+           image_info.sampler == other.image_info.sampler && image_info.imageView == other.image_info.imageView &&
+           image_info.imageLayout == other.image_info.imageLayout;
+}
+
+size_t DescriptorCache::KeyHash::operator()(const Key& key) const {
+    size_t seed = 0;
+    hash_combine(seed, key.layout);
+    for (const Binding& binding : key.bindings) {
+        hash_combine(seed, binding.binding);
+        hash_combine(seed, int(binding.type));
+        hash_combine(seed, binding.buffer_info.buffer);
+        hash_combine(seed, binding.buffer_info.offset);
+        hash_combine(seed, binding.buffer_info.range);
+        hash_combine(seed, binding.image_info.sampler);
+        hash_combine(seed, binding.image_info.imageView);
+        hash_combine(seed, int(binding.image_info.imageLayout));
+    }
+    return seed;
+}
+
+VkResult DescriptorCache::create(VulkanData vkd) {
+    this->vkd = vkd;
+    return allocator.create(vkd, 16);
+}
+
+void DescriptorCache::destroy() {
+    sets.clear();
+    allocator.destroy();
+}
+
+VkResult DescriptorCache::get(VkDescriptorSetLayout layout, const std::vector<Binding>& bindings, VkDescriptorSet& set) {
+    Key key{layout, bindings};
+    auto it = sets.find(key);
+    if (it != sets.end()) {
+        set = it->second;
+        return VK_SUCCESS;
+    }
+
+    VkResult res = allocator.allocate(layout, set);
+    if (res != VK_SUCCESS)
+        return res;
+
+    std::vector<VkWriteDescriptorSet> descriptor_writes(bindings.size());
+    for (size_t i=0; i<bindings.size(); i++) {
+        const Binding& binding = bindings[i];
+        VkWriteDescriptorSet& descriptor_write = descriptor_writes[i];
+        descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptor_write.dstSet = set;
+        descriptor_write.dstBinding = binding.binding;
+        descriptor_write.dstArrayElement = 0;
+        descriptor_write.descriptorType = binding.type;
+        descriptor_write.descriptorCount = 1;
+        if (is_image_type(binding.type))
+            descriptor_write.pImageInfo = &binding.image_info;
+        else
+            descriptor_write.pBufferInfo = &binding.buffer_info;
+    }
+    vkd.vkdf->vkUpdateDescriptorSets(vkd.device, descriptor_writes.size(), descriptor_writes.data(), 0, nullptr);
+
+    sets.emplace(std::move(key), set);
+    return VK_SUCCESS;
+}
+
+void DescriptorCache::clear() {
+    sets.clear();
+    allocator.reset();
+}
\ No newline at end of file
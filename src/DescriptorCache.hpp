@@ -0,0 +1,60 @@
+#ifndef DESCRIPTOR_CACHE_HPP
+#define DESCRIPTOR_CACHE_HPP
+
+#include <QVulkanInstance>
+
+#include <vector>
+#include <unordered_map>
+
+#include "VulkanFunctions.hpp"
+#include "DescriptorAllocator.hpp"
+
+// Long-lived descriptor sets keyed by their layout & the resources written to them
+// A set is allocated & written the first time it is requested, later requests with the same key return the same set
+// Sets are only freed all at once by `clear`, which must be called before resources referred to by cached sets are
+// destroyed if their handles could be reused for new resources
+// Warning: `destroy` will not be called on destructor. It must explicitly be called after `create`
+class DescriptorCache {
+public:
+    // One descriptor (array element 0) of a set
+    struct Binding {
+        uint32_t binding = 0;
+        VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        VkDescriptorBufferInfo buffer_info{}; // Buffer descriptor types
+        VkDescriptorImageInfo image_info{}; // Image & sampler descriptor types
+
+        static Binding buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+        static Binding image(uint32_t binding, VkDescriptorType type, VkImageView image_view, VkSampler sampler, VkImageLayout layout);
+
+        bool operator==(const Binding& other) const;
+    };
+
+    VkResult create(VulkanData vkd);
+    void destroy();
+
+    VkResult get(VkDescriptorSetLayout layout, const std::vector<Binding>& bindings, VkDescriptorSet& set);
+    void clear();
+
+
+    // Getters
+
+    size_t get_nr_sets() {return sets.size();}
+
+private:
+    VulkanData vkd{};
+
+    struct Key {
+        VkDescriptorSetLayout layout;
+        std::vector<Binding> bindings;
+
+        bool operator==(const Key& other) const {return layout == other.layout && bindings == other.bindings;}
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    std::unordered_map<Key, VkDescriptorSet, KeyHash> sets;
+
+    DescriptorAllocator allocator{};
+};
+
+#endif
\ No newline at end of file
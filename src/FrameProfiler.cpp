@@ -0,0 +1,152 @@
+#include "FrameProfiler.hpp"
+
+#include <QDebug>
+
+namespace {
+    // Frame begin & end, then a begin & end query per scope
+    constexpr uint32_t nr_queries = 2 + 2 * FrameProfiler::max_scopes;
+}
+
+VkResult FrameProfiler::create(VulkanData vkd, uint32_t queue_family_index, uint32_t nr_frames) {
+    this->vkd = vkd;
+
+    VkPhysicalDeviceProperties pdp;
+    vkd.vkf->vkGetPhysicalDeviceProperties(vkd.physical_device, &pdp);
+    timestamp_period = pdp.limits.timestampPeriod;
+
+    uint32_t queue_family_count = 0;
+    vkd.vkf->vkGetPhysicalDeviceQueueFamilyProperties(vkd.physical_device, &queue_family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> queue_family_properties(queue_family_count);
+    vkd.vkf->vkGetPhysicalDeviceQueueFamilyProperties(vkd.physical_device, &queue_family_count, queue_family_properties.data());
+    timestamp_valid_bits = queue_family_properties[queue_family_index].timestampValidBits;
+
+    if (timestamp_valid_bits == 0)
+        qWarning("FrameProfiler: Queue family %u doesn't support timestamps. Only CPU times will be measured", queue_family_index);
+
+    frame_slots.resize(nr_frames);
+    clock.start();
+    if (!has_gpu_timestamps())
+        return VK_SUCCESS;
+
+    VkQueryPoolCreateInfo query_pool_info{};
+    query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_info.queryCount = nr_queries;
+
+    for (auto& slot : frame_slots) {
+        VkResult res = vkd.vkdf->vkCreateQueryPool(vkd.device, &query_pool_info, nullptr, &slot.query_pool);
+        if (res != VK_SUCCESS)
+            return res;
+    }
+
+    return VK_SUCCESS;
+}
+
+void FrameProfiler::destroy() {
+    if (vkd.vkdf == nullptr)
+        return;
+
+    for (auto& slot : frame_slots)
+        vkd.vkdf->vkDestroyQueryPool(vkd.device, slot.query_pool, nullptr);
+    frame_slots.clear();
+    current_slot = nullptr;
+
+    results = Results{};
+    vkd = VulkanData{};
+}
+
+void FrameProfiler::begin_frame(uint32_t frame_index, VkCommandBuffer command_buffer, qint64 fence_wait_time_ns) {
+    record_timer.start();
+    qint64 begin_time = clock.nsecsElapsed();
+
+    // The frame's fence has signaled so the previous results of this slot are available
+    FrameSlot& slot = frame_slots[frame_index];
+    if (slot.recorded)
+        read_back(slot);
+
+    slot.scope_names.clear();
+    slot.frame = ++frame_counter;
+    slot.recorded = false;
+    slot.fence_wait_time = fence_wait_time_ns / 1000.0;
+    slot.begin_time = begin_time;
+    current_slot = &slot;
+
+    if (slot.query_pool != VK_NULL_HANDLE) {
+        vkd.vkdf->vkCmdResetQueryPool(command_buffer, slot.query_pool, 0, nr_queries);
+        vkd.vkdf->vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.query_pool, 0);
+    }
+}
+
+void FrameProfiler::end_frame(VkCommandBuffer command_buffer) {
+    if (current_slot == nullptr)
+        return;
+
+    if (current_slot->query_pool != VK_NULL_HANDLE)
+        vkd.vkdf->vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, current_slot->query_pool, 1);
+
+    current_slot->cpu_record_time = record_timer.nsecsElapsed() / 1000.0;
+    current_slot->recorded = true;
+    current_slot = nullptr;
+}
+
+void FrameProfiler::frame_finished(uint32_t frame_index) {
+    frame_slots[frame_index].finished_time = clock.nsecsElapsed();
+}
+
+void FrameProfiler::discard_pending() {
+    for (auto& slot : frame_slots)
+        slot.recorded = false;
+}
+
+uint32_t FrameProfiler::begin_scope(VkCommandBuffer command_buffer, const char* name) {
+    if (current_slot == nullptr || current_slot->scope_names.size() >= max_scopes)
+        return uint32_t(-1);
+
+    uint32_t scope = current_slot->scope_names.size();
+    current_slot->scope_names.push_back(name);
+    if (current_slot->query_pool != VK_NULL_HANDLE)
+        vkd.vkdf->vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, current_slot->query_pool, 2 + 2*scope);
+    return scope;
+}
+
+void FrameProfiler::end_scope(VkCommandBuffer command_buffer, uint32_t scope) {
+    if (current_slot == nullptr || scope >= current_slot->scope_names.size())
+        return;
+
+    if (current_slot->query_pool != VK_NULL_HANDLE)
+        vkd.vkdf->vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, current_slot->query_pool, 3 + 2*scope);
+}
+
+void FrameProfiler::read_back(FrameSlot& slot) {
+    Results frame_results{};
+    frame_results.frame = slot.frame;
+    frame_results.cpu_record_time = slot.cpu_record_time;
+    frame_results.fence_wait_time = slot.fence_wait_time;
+    frame_results.latency = (slot.finished_time - slot.begin_time) / 1000.0;
+
+    if (slot.query_pool != VK_NULL_HANDLE) {
+        uint32_t query_count = 2 + 2*slot.scope_names.size();
+        uint64_t timestamps[nr_queries];
+
+        // No VK_QUERY_RESULT_WAIT_BIT: never stall, skip the GPU part if the results somehow aren't available
+        VkResult res = vkd.vkdf->vkGetQueryPoolResults(
+            vkd.device, slot.query_pool, 0, query_count,
+            sizeof(timestamps), timestamps, sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT
+        );
+
+        if (res == VK_SUCCESS) {
+            uint64_t mask = timestamp_valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << timestamp_valid_bits) - 1;
+            auto elapsed = [&](uint32_t begin, uint32_t end) {
+                return double((timestamps[end] - timestamps[begin]) & mask) * timestamp_period / 1000.0;
+            };
+
+            frame_results.gpu_time = elapsed(0, 1);
+            for (uint32_t i=0; i<slot.scope_names.size(); i++)
+                frame_results.scopes.push_back(Scope{slot.scope_names[i], elapsed(2 + 2*i, 3 + 2*i)});
+        }
+    }
+
+    slot.recorded = false;
+    results = std::move(frame_results);
+}
@@ -0,0 +1,84 @@
+#ifndef FRAME_PROFILER_HPP
+#define FRAME_PROFILER_HPP
+
+#include <QVulkanInstance>
+#include <QElapsedTimer>
+
+#include <vector>
+
+#include "VulkanFunctions.hpp"
+
+// Measures where the time of a frame goes: CPU recording, waiting on the frame's fence & GPU execution
+// GPU times come from timestamp queries (one query pool per frame in flight). They are read back without waiting when
+// the same frame slot comes around again, at which point its fence has signaled
+// Named scopes can be put around work in the frame's command buffer
+// Warning: `destroy` will not be called on destructor. It must explicitly be called after `create`
+class FrameProfiler {
+public:
+    // All times in µs
+    struct Scope {
+        const char* name;
+        double gpu_time;
+    };
+    struct Results {
+        uint64_t frame = 0; // Number of the frame the results belong to (0 if there are no results yet)
+        double cpu_record_time = 0.0; // From the start of recording to submission
+        double fence_wait_time = 0.0; // Waiting for the frame's resources to be free before recording
+        double gpu_time = 0.0; // 0 if the queue doesn't support timestamps
+        // From the start of recording until the frame's fence was seen signaled. Exact if the CPU had to wait for it,
+        // otherwise an upper bound (the fence is only checked when the frame slot comes around again)
+        double latency = 0.0;
+        std::vector<Scope> scopes;
+    };
+
+    static constexpr uint32_t max_scopes = 16;
+
+    VkResult create(VulkanData vkd, uint32_t queue_family_index, uint32_t nr_frames);
+    void destroy();
+
+    // Called by the render target around the recording of every frame
+    // `begin_frame` must be called right after the command buffer begins (outside a render pass)
+    void begin_frame(uint32_t frame_index, VkCommandBuffer command_buffer, qint64 fence_wait_time_ns);
+    void end_frame(VkCommandBuffer command_buffer);
+    // Called by the render target right after waiting on the fence of `frame_index`
+    void frame_finished(uint32_t frame_index);
+    // Drops the frames that weren't read back yet (needed when the frame slots get reassigned)
+    void discard_pending();
+
+    // `name` has to outlive the profiler (use string literals). Every begun scope must be ended in the same frame
+    // Returns an id for `end_scope`
+    uint32_t begin_scope(VkCommandBuffer command_buffer, const char* name);
+    void end_scope(VkCommandBuffer command_buffer, uint32_t scope);
+
+    // Results of the most recent frame that finished on the GPU
+    const Results& get_results() {return results;}
+    bool has_gpu_timestamps() {return timestamp_valid_bits != 0;}
+
+private:
+    VulkanData vkd{};
+
+    double timestamp_period = 1.0; // ns per tick
+    uint32_t timestamp_valid_bits = 0;
+
+    struct FrameSlot {
+        VkQueryPool query_pool = VK_NULL_HANDLE;
+        std::vector<const char*> scope_names;
+        uint64_t frame = 0;
+        bool recorded = false;
+        double cpu_record_time = 0.0;
+        double fence_wait_time = 0.0;
+        qint64 begin_time = 0; // ns on `clock`
+        qint64 finished_time = 0;
+    };
+    std::vector<FrameSlot> frame_slots;
+    FrameSlot* current_slot = nullptr;
+
+    void read_back(FrameSlot& slot);
+
+    QElapsedTimer record_timer;
+    QElapsedTimer clock;
+    uint64_t frame_counter = 0;
+    Results results{};
+};
+
+#endif
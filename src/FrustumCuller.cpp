@@ -0,0 +1,217 @@
+#include "FrustumCuller.hpp"
+
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define FRUSTUM_CULLER_SSE
+#include <immintrin.h>
+#endif
+
+// AVX2 code is compiled with a function target attribute & only run if the CPU supports it
+#if defined(FRUSTUM_CULLER_SSE) && defined(__GNUC__)
+#define FRUSTUM_CULLER_AVX2
+#endif
+
+namespace {
+    const uint32_t padding = 8;
+    // -radius is +infinity, so no plane distance passes the test
+    const float invisible_radius = -std::numeric_limits<float>::infinity();
+
+    uint32_t cull_scalar(const float* x, const float* y, const float* z, const float* r, uint32_t count,
+                         const FrustumCuller::Frustum& frustum, uint32_t* visible) {
+        uint32_t nr_visible = 0;
+        for (uint32_t i=0; i<count; i++) {
+            bool inside = true;
+            for (int p=0; p<6 && inside; p++) {
+                const glm::vec4& plane = frustum.planes[p];
+                inside = plane.x*x[i] + plane.y*y[i] + plane.z*z[i] + plane.w >= -r[i];
+            }
+            if (inside)
+                visible[nr_visible++] = i;
+        }
+        return nr_visible;
+    }
+
+    // Appends the set bits of `mask` (lane indices) offset by `base`
+    inline uint32_t append_lanes(uint32_t mask, uint32_t base, uint32_t* visible, uint32_t nr_visible) {
+        while (mask != 0) {
+#if defined(__GNUC__)
+            uint32_t lane = __builtin_ctz(mask);
+#else
+            unsigned long lane;
+            _BitScanForward(&lane, mask);
+#endif
+            visible[nr_visible++] = base + lane;
+            mask &= mask - 1;
+        }
+        return nr_visible;
+    }
+
+#ifdef FRUSTUM_CULLER_SSE
+    uint32_t cull_sse(const float* x, const float* y, const float* z, const float* r, uint32_t count,
+                      const FrustumCuller::Frustum& frustum, uint32_t* visible) {
+        __m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+        for (int p=0; p<6; p++) {
+            plane_x[p] = _mm_set1_ps(frustum.planes[p].x);
+            plane_y[p] = _mm_set1_ps(frustum.planes[p].y);
+            plane_z[p] = _mm_set1_ps(frustum.planes[p].z);
+            plane_w[p] = _mm_set1_ps(frustum.planes[p].w);
+        }
+
+        uint32_t nr_visible = 0;
+        for (uint32_t i=0; i<count; i+=4) {
+            __m128 cx = _mm_loadu_ps(x + i);
+            __m128 cy = _mm_loadu_ps(y + i);
+            __m128 cz = _mm_loadu_ps(z + i);
+            __m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r + i));
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p=0; p<6; p++) {
+                __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(plane_x[p], cx), _mm_mul_ps(plane_y[p], cy)),
+                    _mm_add_ps(_mm_mul_ps(plane_z[p], cz), plane_w[p])
+                );
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negative_radius));
+            }
+            nr_visible = append_lanes(_mm_movemask_ps(inside), i, visible, nr_visible);
+        }
+        return nr_visible;
+    }
+#endif
+
+#ifdef FRUSTUM_CULLER_AVX2
+    __attribute__((target("avx2")))
+    uint32_t cull_avx2(const float* x, const float* y, const float* z, const float* r, uint32_t count,
+                       const FrustumCuller::Frustum& frustum, uint32_t* visible) {
+        __m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+        for (int p=0; p<6; p++) {
+            plane_x[p] = _mm256_set1_ps(frustum.planes[p].x);
+            plane_y[p] = _mm256_set1_ps(frustum.planes[p].y);
+            plane_z[p] = _mm256_set1_ps(frustum.planes[p].z);
+            plane_w[p] = _mm256_set1_ps(frustum.planes[p].w);
+        }
+
+        uint32_t nr_visible = 0;
+        for (uint32_t i=0; i<count; i+=8) {
+            __m256 cx = _mm256_loadu_ps(x + i);
+            __m256 cy = _mm256_loadu_ps(y + i);
+            __m256 cz = _mm256_loadu_ps(z + i);
+            __m256 negative_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(r + i));
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p=0; p<6; p++) {
+                __m256 distance = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(plane_x[p], cx), _mm256_mul_ps(plane_y[p], cy)),
+                    _mm256_add_ps(_mm256_mul_ps(plane_z[p], cz), plane_w[p])
+                );
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negative_radius, _CMP_GE_OQ));
+            }
+            nr_visible = append_lanes(_mm256_movemask_ps(inside), i, visible, nr_visible);
+        }
+        return nr_visible;
+    }
+#endif
+}
+
+FrustumCuller::Frustum FrustumCuller::extract_frustum(const glm::mat4& view_projection) {
+    // Rows of the matrix (glm is column-major)
+    glm::vec4 rows[4];
+    for (int i=0; i<4; i++)
+        rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0]; // Left
+    frustum.planes[1] = rows[3] - rows[0]; // Right
+    frustum.planes[2] = rows[3] + rows[1]; // Bottom
+    frustum.planes[3] = rows[3] - rows[1]; // Top
+    frustum.planes[4] = rows[2];           // Near (depth range [0,1])
+    frustum.planes[5] = rows[3] - rows[2]; // Far
+
+    for (auto& plane : frustum.planes)
+        plane = plane / glm::length(glm::vec3(plane.x, plane.y, plane.z));
+    return frustum;
+}
+
+FrustumCuller::FrustumCuller() {
+    set_path(Path::AVX2);
+}
+
+uint32_t FrustumCuller::add_sphere(glm::vec3 center, float radius) {
+    uint32_t index = nr_spheres++;
+    if (nr_spheres > center_x.size()) {
+        size_t padded_size = center_x.size() + padding;
+        center_x.resize(padded_size, 0.0f);
+        center_y.resize(padded_size, 0.0f);
+        center_z.resize(padded_size, 0.0f);
+        this->radius.resize(padded_size, invisible_radius);
+    }
+    set_sphere(index, center, radius);
+    return index;
+}
+
+void FrustumCuller::set_sphere(uint32_t index, glm::vec3 center, float radius) {
+    center_x[index] = center.x;
+    center_y[index] = center.y;
+    center_z[index] = center.z;
+    this->radius[index] = radius;
+}
+
+void FrustumCuller::clear() {
+    nr_spheres = 0;
+    center_x.clear();
+    center_y.clear();
+    center_z.clear();
+    radius.clear();
+}
+
+void FrustumCuller::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const {
+    // The SIMD paths process the padding too, which is never visible
+    uint32_t padded_count = center_x.size();
+    visible.resize(padded_count);
+
+    uint32_t nr_visible;
+    switch (path) {
+#ifdef FRUSTUM_CULLER_AVX2
+    case Path::AVX2:
+        nr_visible = cull_avx2(center_x.data(), center_y.data(), center_z.data(), radius.data(), padded_count, frustum, visible.data());
+        break;
+#endif
+#ifdef FRUSTUM_CULLER_SSE
+    case Path::SSE:
+        nr_visible = cull_sse(center_x.data(), center_y.data(), center_z.data(), radius.data(), padded_count, frustum, visible.data());
+        break;
+#endif
+    default:
+        nr_visible = cull_scalar(center_x.data(), center_y.data(), center_z.data(), radius.data(), nr_spheres, frustum, visible.data());
+        break;
+    }
+    visible.resize(nr_visible);
+}
+
+bool FrustumCuller::is_path_supported(Path path) {
+    switch (path) {
+    case Path::Scalar:
+        return true;
+    case Path::SSE:
+#ifdef FRUSTUM_CULLER_SSE
+        return true;
+#else
+        return false;
+#endif
+    case Path::AVX2:
+#ifdef FRUSTUM_CULLER_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+void FrustumCuller::set_path(Path path) {
+    if (path == Path::AVX2 && !is_path_supported(Path::AVX2))
+        path = Path::SSE;
+    if (path == Path::SSE && !is_path_supported(Path::SSE))
+        path = Path::Scalar;
+    this->path = path;
+}
\ No newline at end of file
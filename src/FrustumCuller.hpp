@@ -0,0 +1,57 @@
+#ifndef FRUSTUM_CULLER_HPP
+#define FRUSTUM_CULLER_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// Tests bounding spheres against a view frustum, 4 (SSE) or 8 (AVX2) at a time
+// The spheres are stored as structure of arrays, padded to a multiple of 8 with spheres that are never visible
+class FrustumCuller {
+public:
+    enum class Path {
+        Scalar,
+        SSE,
+        AVX2,
+    };
+
+    // Normalized planes (xyz: inward normal, w: distance), inside is dot(plane.xyz, p) + plane.w >= 0
+    struct Frustum {
+        glm::vec4 planes[6];
+    };
+    // Planes of the clip volume of `view_projection` (with a [0,1] depth range)
+    static Frustum extract_frustum(const glm::mat4& view_projection);
+
+    // Uses the fastest path the CPU supports
+    FrustumCuller();
+
+    // Returns the index of the new sphere
+    uint32_t add_sphere(glm::vec3 center, float radius);
+    void set_sphere(uint32_t index, glm::vec3 center, float radius);
+    void clear();
+
+    // Writes the indices of the spheres intersecting `frustum` to `visible` in ascending order & resizes it to their count
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+    static bool is_path_supported(Path path);
+    // Falls back to the next slower path if `path` isn't supported
+    void set_path(Path path);
+
+
+    // Getters
+
+    uint32_t get_nr_spheres() const {return nr_spheres;}
+    Path get_path() const {return path;}
+
+private:
+    Path path = Path::Scalar;
+
+    uint32_t nr_spheres = 0;
+    std::vector<float> center_x;
+    std::vector<float> center_y;
+    std::vector<float> center_z;
+    std::vector<float> radius;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "HeadlessRenderTarget.hpp"
+
+HeadlessRenderTarget::HeadlessRenderTarget(AbstractVulkanRenderer* vulkan_renderer, QVulkanInstance* instance, VkExtent2D extent) :
+    VulkanRenderTarget(vulkan_renderer),
+    instance(instance),
+    extent(extent)
+{}
+
+HeadlessRenderTarget::~HeadlessRenderTarget() {
+    stop();
+}
+
+void HeadlessRenderTarget::start() {
+    if (status == Status::Uninitialized)
+        init_resources();
+    if (status == Status::Device_Ready)
+        init_swap_chain_resources();
+    update_requested = true;
+}
+
+uint32_t HeadlessRenderTarget::render_frames(uint32_t nr_frames) {
+    uint32_t nr_rendered_frames = 0;
+    while (status == Status::Ready && update_requested && nr_rendered_frames < nr_frames) {
+        update_requested = false;
+        begin_frame();
+        nr_rendered_frames++;
+    }
+    return nr_rendered_frames;
+}
+
+void HeadlessRenderTarget::stop() {
+    if (status == Status::Ready)
+        release_swap_chain_resources();
+    if (status == Status::Device_Ready)
+        release_resources();
+}
+
+void HeadlessRenderTarget::resize(VkExtent2D extent) {
+    this->extent = extent;
+    if (status == Status::Ready)
+        recreate_swap_chain();
+}
+
+
+// Render Target Functions:
+//=========================
+
+void HeadlessRenderTarget::create_color_images() {
+    image_extent = extent;
+    // One per frame in flight, whatever their number
+    image_count = max_frames_in_flight;
+
+    Image::CreateData icd{};
+    icd.width = image_extent.width;
+    icd.height = image_extent.height;
+    icd.format = color_format;
+    icd.tiling = VK_IMAGE_TILING_OPTIMAL;
+    icd.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    icd.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    icd.aspect_flags = VK_IMAGE_ASPECT_COLOR_BIT;
+
+    if (!color_images.empty()) {
+        std::vector<Image> old_color_images = std::move(color_images);
+        defer_deletion([old_color_images]() mutable {
+            for (auto& color_image : old_color_images)
+                color_image.destroy();
+        });
+    }
+
+    color_images.clear();
+    color_images.resize(image_count);
+    image_resources.resize(image_count);
+    for (uint32_t i=0; i<image_count; i++) {
+        VkResult res = color_images[i].create(vkd, icd);
+        if (res != VK_SUCCESS)
+            qFatal("HeadlessRenderTarget: Failed to create color image: %d", res);
+        image_resources[i].image = color_images[i].get_vk_image();
+    }
+}
+
+void HeadlessRenderTarget::destroy_color_images() {
+    for (auto& color_image : color_images)
+        color_image.destroy();
+    color_images.clear();
+}
+
+bool HeadlessRenderTarget::acquire_next_image(VkSemaphore, uint32_t& image_index) {
+    // Every frame in flight has its own image, which is free again once the frame's fence has signaled
+    image_index = frame_index;
+    return true;
+}
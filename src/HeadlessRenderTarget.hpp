@@ -0,0 +1,54 @@
+#ifndef HEADLESS_RENDER_TARGET_HPP
+#define HEADLESS_RENDER_TARGET_HPP
+
+#include <QVulkanInstance>
+
+#include <vector>
+
+#include "VulkanRenderTarget.hpp"
+#include "Image.hpp"
+
+// Render target without a window or swapchain, rendering into offscreen color images
+// Meant for automated benchmarks (e.g. on a software ICD like lavapipe or SwiftShader)
+// There is one color image per frame in flight. It is left in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL so it can be read back
+class HeadlessRenderTarget : public VulkanRenderTarget {
+public:
+    HeadlessRenderTarget(AbstractVulkanRenderer* vulkan_renderer, QVulkanInstance* instance, VkExtent2D extent);
+    ~HeadlessRenderTarget();
+
+    QVulkanInstance* get_vulkan_instance() override {return instance;}
+    void request_update() override {update_requested = true;}
+
+    // Initialize the device & images (what exposing a window does)
+    void start();
+    // Render frames back to back until `nr_frames` were rendered or the renderer stops calling `request_update`
+    // Returns the number of rendered frames
+    uint32_t render_frames(uint32_t nr_frames);
+    // Wait for all frames to finish & release everything
+    void stop();
+
+    void resize(VkExtent2D extent);
+
+protected:
+    bool uses_presentation_engine() override {return false;}
+    bool supports_present(VkPhysicalDevice, uint32_t) override {return false;}
+
+    VkFormat choose_color_format() override {return VK_FORMAT_R8G8B8A8_UNORM;}
+    VkImageLayout get_color_final_layout() override {return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;}
+
+    void create_color_images() override;
+    void destroy_color_images() override;
+
+    bool acquire_next_image(VkSemaphore image_available_semaphore, uint32_t& image_index) override;
+    void present_image(VkSemaphore, uint32_t) override {}
+
+private:
+    QVulkanInstance* instance;
+    VkExtent2D extent;
+
+    bool update_requested = false;
+
+    std::vector<Image> color_images;
+};
+
+#endif
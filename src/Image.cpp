@@ -2,6 +2,8 @@
 
 #include <QDebug>
 
+#include <algorithm>
+
 VkResult Image::create(VulkanData vkd, const CreateData& img_data) {
     this->vkd = vkd;
     this->img_data = img_data;
@@ -12,8 +14,8 @@ VkResult Image::create(VulkanData vkd, const CreateData& img_data) {
     image_info.extent.width = img_data.width;
     image_info.extent.height = img_data.height;
     image_info.extent.depth = 1;
-    image_info.mipLevels = 1;
-    image_info.arrayLayers = 1;
+    image_info.mipLevels = img_data.mip_levels;
+    image_info.arrayLayers = img_data.array_layers;
     image_info.format = img_data.format;
     image_info.tiling = img_data.tiling;
     image_info.usage = img_data.usage;
@@ -27,42 +29,53 @@ VkResult Image::create(VulkanData vkd, const CreateData& img_data) {
     VkMemoryRequirements memory_requirements;
     vkd.vkdf->vkGetImageMemoryRequirements(vkd.device, image, &memory_requirements);
 
-    VkMemoryAllocateInfo allocation_info{};
-    allocation_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocation_info.allocationSize = memory_requirements.size;
-    allocation_info.memoryTypeIndex = find_memory_type(vkd, memory_requirements.memoryTypeBits, img_data.properties);
-    if (allocation_info.memoryTypeIndex == uint32_t(-1)) return VK_ERROR_UNKNOWN;
-
-    res = vkd.vkdf->vkAllocateMemory(vkd.device, &allocation_info, nullptr, &image_memory);
+    res = vkd.allocator->allocate(memory_requirements, img_data.properties, 0, img_data.tiling == VK_IMAGE_TILING_LINEAR, allocation);
     if (res != VK_SUCCESS)
         return res;
 
-    vkd.vkdf->vkBindImageMemory(vkd.device, image, image_memory, 0);
+    vkd.vkdf->vkBindImageMemory(vkd.device, image, allocation.memory, allocation.offset);
 
     return VK_SUCCESS;
 }
 
-VkResult Image::create_view(VulkanData vkd, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, VkImageView& image_view) {
+uint32_t Image::get_max_mip_levels(uint32_t width, uint32_t height) {
+    uint32_t mip_levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+        mip_levels++;
+    return mip_levels;
+}
+
+VkResult Image::create_view(VulkanData vkd, VkImage image, VkImageViewType view_type, VkFormat format, const VkImageSubresourceRange& subresource_range, VkImageView& image_view) {
     VkImageViewCreateInfo view_info{};
     view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     view_info.image = image;
-    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.viewType = view_type;
     view_info.format = format;
-    view_info.subresourceRange.aspectMask = aspect_flags;
-    view_info.subresourceRange.baseMipLevel = 0;
-    view_info.subresourceRange.levelCount = 1;
-    view_info.subresourceRange.baseArrayLayer = 0;
-    view_info.subresourceRange.layerCount = 1;
-    
+    view_info.subresourceRange = subresource_range;
+
     return vkd.vkdf->vkCreateImageView(vkd.device, &view_info, nullptr, &image_view);
 }
 
+VkResult Image::create_view(VulkanData vkd, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, VkImageView& image_view) {
+    VkImageSubresourceRange subresource_range{};
+    subresource_range.aspectMask = aspect_flags;
+    subresource_range.baseMipLevel = 0;
+    subresource_range.levelCount = 1;
+    subresource_range.baseArrayLayer = 0;
+    subresource_range.layerCount = 1;
+
+    return Image::create_view(vkd, image, VK_IMAGE_VIEW_TYPE_2D, format, subresource_range, image_view);
+}
+
 VkResult Image::create_view(VkImageAspectFlags aspect_flags) {
-    return Image::create_view(vkd, image, img_data.format, aspect_flags, image_view);
+    VkImageSubresourceRange subresource_range = get_subresource_range();
+    subresource_range.aspectMask = aspect_flags;
+    VkImageViewType view_type = img_data.array_layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+    return Image::create_view(vkd, image, view_type, img_data.format, subresource_range, image_view);
 }
 
 VkResult Image::create_view() {
-    return Image::create_view(vkd, image, img_data.format, img_data.aspect_flags, image_view);
+    return create_view(img_data.aspect_flags);
 }
 
 inline VkSamplerCreateInfo Image::default_texture_sampler_create_info(VkFilter filter, VkSamplerAddressMode address_mode, VkBool32 anisotropy_enabled) {
@@ -98,6 +111,12 @@ inline VkResult Image::create_sampler(VkSamplerCreateInfo create_info) {
 
 void Image::destroy() {
     if (vkd.vkdf != nullptr) {
+        for (VkImageView mip_view : mip_views)
+            vkd.vkdf->vkDestroyImageView(vkd.device, mip_view, nullptr);
+        mip_views.clear();
+        vkd.vkdf->vkDestroyDescriptorPool(vkd.device, mip_descriptor_pool, nullptr);
+        mip_descriptor_pool = VK_NULL_HANDLE;
+
         vkd.vkdf->vkDestroySampler(vkd.device, sampler, nullptr);
         sampler = VK_NULL_HANDLE;
         vkd.vkdf->vkDestroyImageView(vkd.device, image_view, nullptr);
@@ -105,8 +124,8 @@ void Image::destroy() {
 
         vkd.vkdf->vkDestroyImage(vkd.device, image, nullptr);
         image = VK_NULL_HANDLE;
-        vkd.vkdf->vkFreeMemory(vkd.device, image_memory, nullptr);
-        image_memory = VK_NULL_HANDLE;
+        if (vkd.allocator != nullptr)
+            vkd.allocator->free(allocation);
 
         vkd = VulkanData{};
         img_data = CreateData{};
@@ -114,7 +133,7 @@ void Image::destroy() {
     }
 }
 
-void Image::transition_image_layout(VulkanData vkd, VkImageLayout old_layout, VkImageLayout new_layout, VkImageAspectFlags aspect_flags, VkImage image, VkCommandBuffer command_buffer) {
+void Image::transition_image_layout(VulkanData vkd, VkImageLayout old_layout, VkImageLayout new_layout, const VkImageSubresourceRange& subresource_range, VkImage image, VkCommandBuffer command_buffer) {
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = old_layout;
@@ -122,11 +141,7 @@ void Image::transition_image_layout(VulkanData vkd, VkImageLayout old_layout, Vk
     barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.image = image;
-    barrier.subresourceRange.aspectMask = aspect_flags;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange = subresource_range;
 
     VkPipelineStageFlags src_stage;
     VkPipelineStageFlags dst_stage;
@@ -145,6 +160,34 @@ void Image::transition_image_layout(VulkanData vkd, VkImageLayout old_layout, Vk
         src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
         dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     }
+    else if (old_layout==VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && new_layout==VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    else if (old_layout==VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && new_layout==VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    }
+    else if (old_layout==VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && new_layout==VK_IMAGE_LAYOUT_GENERAL) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dst_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    }
+    else if (old_layout==VK_IMAGE_LAYOUT_GENERAL && new_layout==VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        src_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    }
     else if (old_layout==VK_IMAGE_LAYOUT_UNDEFINED && new_layout==VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
         barrier.srcAccessMask = 0;
         barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
@@ -166,6 +209,17 @@ void Image::transition_image_layout(VulkanData vkd, VkImageLayout old_layout, Vk
     );
 }
 
+void Image::transition_image_layout(VulkanData vkd, VkImageLayout old_layout, VkImageLayout new_layout, VkImageAspectFlags aspect_flags, VkImage image, VkCommandBuffer command_buffer) {
+    VkImageSubresourceRange subresource_range{};
+    subresource_range.aspectMask = aspect_flags;
+    subresource_range.baseMipLevel = 0;
+    subresource_range.levelCount = VK_REMAINING_MIP_LEVELS;
+    subresource_range.baseArrayLayer = 0;
+    subresource_range.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+    Image::transition_image_layout(vkd, old_layout, new_layout, subresource_range, image, command_buffer);
+}
+
 void Image::transition_image_layout(VkImageLayout old_layout, VkImageLayout new_layout, VkImageAspectFlags aspect_flags, VkCommandBuffer command_buffer) {
     Image::transition_image_layout(vkd, old_layout, new_layout, aspect_flags, image, command_buffer);
 }
@@ -174,16 +228,16 @@ void Image::transition_image_layout(VkImageLayout old_layout, VkImageLayout new_
     Image::transition_image_layout(vkd, old_layout, new_layout, img_data.aspect_flags, image, command_buffer);
 }
 
-void Image::copy_buffer_to_image(VulkanData vkd, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkCommandBuffer command_buffer) {
+void Image::copy_buffer_to_image(VulkanData vkd, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkCommandBuffer command_buffer, VkDeviceSize buffer_offset, uint32_t mip_level, uint32_t layer_count) {
     VkBufferImageCopy region{};
-    region.bufferOffset = 0;
+    region.bufferOffset = buffer_offset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
 
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.mipLevel = mip_level;
     region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
+    region.imageSubresource.layerCount = layer_count;
 
     region.imageOffset = {0,0,0};
     region.imageExtent = {width, height, 1};
@@ -191,6 +245,20 @@ void Image::copy_buffer_to_image(VulkanData vkd, VkBuffer buffer, VkImage image,
     vkd.vkdf->vkCmdCopyBufferToImage(command_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 }
 
-void Image::copy_buffer_to_image(VkBuffer buffer, VkCommandBuffer command_buffer) {
-    copy_buffer_to_image(vkd, buffer, image, img_data.width, img_data.height, command_buffer);
+void Image::copy_buffer_to_image(VkBuffer buffer, VkCommandBuffer command_buffer, VkDeviceSize buffer_offset) {
+    copy_buffer_to_image(vkd, buffer, image, img_data.width, img_data.height, command_buffer, buffer_offset, 0, img_data.array_layers);
+}
+
+VkExtent2D Image::get_mip_extent(uint32_t mip_level) {
+    return VkExtent2D{std::max(img_data.width >> mip_level, 1u), std::max(img_data.height >> mip_level, 1u)};
+}
+
+VkImageSubresourceRange Image::get_subresource_range() {
+    VkImageSubresourceRange subresource_range{};
+    subresource_range.aspectMask = img_data.aspect_flags;
+    subresource_range.baseMipLevel = 0;
+    subresource_range.levelCount = img_data.mip_levels;
+    subresource_range.baseArrayLayer = 0;
+    subresource_range.layerCount = img_data.array_layers;
+    return subresource_range;
 }
\ No newline at end of file
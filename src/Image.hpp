@@ -2,7 +2,11 @@
 #define IMAGE_HPP
 
 #include <QVulkanInstance>
+
+#include <vector>
+
 #include "VulkanFunctions.hpp"
+#include "MemoryAllocator.hpp"
 
 // Warning: `destroy` will not be called on destructor. It must explicitly be called after `create`
 class Image {
@@ -22,13 +26,22 @@ public:
         VkSampleCountFlagBits sample_count = VK_SAMPLE_COUNT_1_BIT;
         VkSharingMode sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
 
+        uint32_t mip_levels = 1; // See `get_max_mip_levels` for a full mip chain
+        uint32_t array_layers = 1; // Views get the VK_IMAGE_VIEW_TYPE_2D_ARRAY type if there is more than one layer
+
         static CreateData default_texture_data(uint32_t width=0, uint32_t height=0) {
             return CreateData{width, height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_ASPECT_COLOR_BIT,};
         }
     };
     VkResult create(VulkanData vkd, const CreateData& icd);
 
+    // Number of mip levels of a full mip chain down to 1x1
+    static uint32_t get_max_mip_levels(uint32_t width, uint32_t height);
+
+    static VkResult create_view(VulkanData vkd, VkImage image, VkImageViewType view_type, VkFormat format, const VkImageSubresourceRange& subresource_range, VkImageView& image_view);
+    // View of the first mip level & layer
     static VkResult create_view(VulkanData vkd, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, VkImageView& image_view);
+    // Views of all mip levels & layers
     // Use special `VkImageAspectFlags` instead of the one specified in create_data
     VkResult create_view(VkImageAspectFlags aspect_flags);
     VkResult create_view();
@@ -44,30 +57,44 @@ public:
     // Image operations
 
     // Transition done in transfer stage
+    static void transition_image_layout(VulkanData vkd, VkImageLayout old_layout, VkImageLayout new_layout, const VkImageSubresourceRange& subresource_range, VkImage image, VkCommandBuffer command_buffer);
+    // Transitions all mip levels & layers
     static void transition_image_layout(VulkanData vkd, VkImageLayout old_layout, VkImageLayout new_layout, VkImageAspectFlags aspect_flags, VkImage image, VkCommandBuffer command_buffer);
     // Use special `VkImageAspectFlags` instead of the one specified in create_data
     void transition_image_layout(VkImageLayout old_layout, VkImageLayout new_layout, VkImageAspectFlags aspect_flags, VkCommandBuffer command_buffer);
     void transition_image_layout(VkImageLayout old_layout, VkImageLayout new_layout, VkCommandBuffer command_buffer);
 
-    static void copy_buffer_to_image(VulkanData vkd, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkCommandBuffer command_buffer);
-    void copy_buffer_to_image(VkBuffer buffer, VkCommandBuffer command_buffer);
+    // `width` & `height` are the extent of `mip_level`. The layers have to follow each other tightly in the buffer
+    static void copy_buffer_to_image(VulkanData vkd, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkCommandBuffer command_buffer, VkDeviceSize buffer_offset=0, uint32_t mip_level=0, uint32_t layer_count=1);
+    // Copies into every layer of the first mip level
+    void copy_buffer_to_image(VkBuffer buffer, VkCommandBuffer command_buffer, VkDeviceSize buffer_offset=0);
 
 
     // Getters
 
     VkImage get_vk_image() {return image;}
-    VkDeviceMemory get_vk_image_memory() {return image_memory;}
+    VkDeviceMemory get_vk_image_memory() {return allocation.memory;}
+    // Offset of the image inside `get_vk_image_memory()`
+    VkDeviceSize get_memory_offset() {return allocation.offset;}
     VkImageView get_vk_image_view() {return image_view;}
     VkSampler get_vk_sampler() {return sampler;}
     const CreateData& get_image_data() {return img_data;}
+    VkExtent2D get_mip_extent(uint32_t mip_level);
+    VkImageSubresourceRange get_subresource_range();
     const VkSamplerCreateInfo& get_sampler_create_info() {return sampler_create_info;}
 
 private:
     VkImage image = VK_NULL_HANDLE;
-    VkDeviceMemory image_memory = VK_NULL_HANDLE;
+    MemoryAllocator::Allocation allocation{};
     VkImageView image_view = VK_NULL_HANDLE;
     VkSampler sampler = VK_NULL_HANDLE;
 
+    // Per mip level views & their descriptors, created by MipGenerator for its compute path
+    // They live as long as the image because the commands using them may still be executing after `generate` returns
+    friend class MipGenerator;
+    std::vector<VkImageView> mip_views;
+    VkDescriptorPool mip_descriptor_pool = VK_NULL_HANDLE;
+
     VulkanData vkd{};
     CreateData img_data{};
     VkSamplerCreateInfo sampler_create_info{};
@@ -0,0 +1,169 @@
+#include "Ktx2Texture.hpp"
+#include "Image.hpp"
+
+#include <QFile>
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    const unsigned char ktx2_identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    // Fixed part of the KTX2 header (little endian, followed by the level index)
+    struct FileHeader {
+        unsigned char identifier[12];
+        uint32_t vk_format;
+        uint32_t type_size;
+        uint32_t pixel_width;
+        uint32_t pixel_height;
+        uint32_t pixel_depth;
+        uint32_t layer_count;
+        uint32_t face_count;
+        uint32_t level_count;
+        uint32_t supercompression_scheme;
+        uint32_t dfd_byte_offset;
+        uint32_t dfd_byte_length;
+        uint32_t kvd_byte_offset;
+        uint32_t kvd_byte_length;
+        uint64_t sgd_byte_offset;
+        uint64_t sgd_byte_length;
+    };
+    static_assert(sizeof(FileHeader) == 80, "Unexpected KTX2 header size");
+
+    struct LevelIndexEntry {
+        uint64_t byte_offset;
+        uint64_t byte_length;
+        uint64_t uncompressed_byte_length;
+    };
+    static_assert(sizeof(LevelIndexEntry) == 24, "Unexpected KTX2 level index size");
+
+    // Keeps every level's offset valid for block-compressed copies (which need multiples of the block size & 4)
+    const VkDeviceSize level_alignment = 16;
+}
+
+bool Ktx2Texture::load(const QString& path) {
+    header = Header{};
+    level_data.clear();
+    level_offsets.clear();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning("Ktx2Texture: Failed to open %s", qPrintable(path));
+        return false;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+
+    if (!parse_header(data, path, header))
+        return false;
+
+    size_t level_index_size = header.mip_levels * sizeof(LevelIndexEntry);
+    if (size_t(data.size()) < sizeof(FileHeader) + level_index_size) {
+        qWarning("Ktx2Texture: %s is truncated", qPrintable(path));
+        return false;
+    }
+    std::vector<LevelIndexEntry> level_index(header.mip_levels);
+    memcpy(level_index.data(), data.constData() + sizeof(FileHeader), level_index_size);
+
+    VkDeviceSize total_size = 0;
+    for (const auto& level : level_index) {
+        if (level.byte_offset + level.byte_length > uint64_t(data.size()) || level.byte_length == 0) {
+            qWarning("Ktx2Texture: %s has invalid level data", qPrintable(path));
+            return false;
+        }
+        level_offsets.push_back(total_size);
+        total_size = align_to(total_size + level.byte_length, level_alignment);
+    }
+
+    level_data = QByteArray(total_size, Qt::Uninitialized);
+    for (uint32_t level=0; level<header.mip_levels; level++)
+        memcpy(level_data.data() + level_offsets[level], data.constData() + level_index[level].byte_offset, level_index[level].byte_length);
+
+    return true;
+}
+
+bool Ktx2Texture::read_header(const QString& path, Header& header) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QByteArray data = file.read(sizeof(FileHeader));
+    file.close();
+
+    return parse_header(data, path, header);
+}
+
+bool Ktx2Texture::parse_header(const QByteArray& data, const QString& path, Header& header) {
+    if (size_t(data.size()) < sizeof(FileHeader)) {
+        qWarning("Ktx2Texture: %s is truncated", qPrintable(path));
+        return false;
+    }
+    FileHeader file_header;
+    memcpy(&file_header, data.constData(), sizeof(FileHeader));
+
+    if (memcmp(file_header.identifier, ktx2_identifier, sizeof(ktx2_identifier)) != 0) {
+        qWarning("Ktx2Texture: %s is not a KTX2 file", qPrintable(path));
+        return false;
+    }
+    if (file_header.vk_format == VK_FORMAT_UNDEFINED || file_header.supercompression_scheme != 0) {
+        qWarning("Ktx2Texture: %s needs transcoding or decompression, which isn't supported", qPrintable(path));
+        return false;
+    }
+    if (file_header.pixel_width == 0 || file_header.pixel_height == 0 || file_header.pixel_depth > 1 || file_header.face_count != 1) {
+        qWarning("Ktx2Texture: %s is not a 2D texture", qPrintable(path));
+        return false;
+    }
+
+    header.format = VkFormat(file_header.vk_format);
+    header.width = file_header.pixel_width;
+    header.height = file_header.pixel_height;
+    header.array_layers = std::max(file_header.layer_count, 1u);
+    if (file_header.level_count > Image::get_max_mip_levels(header.width, header.height)) {
+        qWarning("Ktx2Texture: %s has more mip levels than its size allows", qPrintable(path));
+        return false;
+    }
+    // A level count of 0 asks the loader to generate the mip levels, only the first one is stored
+    header.mip_levels = std::max(file_header.level_count, 1u);
+    header.generate_mip_levels = file_header.level_count == 0;
+    return true;
+}
+
+bool Ktx2Texture::is_block_compressed(VkFormat format) {
+    return (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK)
+        || (format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK)
+        || (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK);
+}
+
+bool Ktx2Texture::is_format_supported(VulkanData vkd, const VkPhysicalDeviceFeatures& enabled_features, VkFormat format) {
+    if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK && !enabled_features.textureCompressionBC)
+        return false;
+    if (format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK && !enabled_features.textureCompressionETC2)
+        return false;
+    if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK && !enabled_features.textureCompressionASTC_LDR)
+        return false;
+
+    VkFormatProperties properties;
+    vkd.vkf->vkGetPhysicalDeviceFormatProperties(vkd.physical_device, format, &properties);
+    VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & features) == features;
+}
+
+std::vector<VkBufferImageCopy> Ktx2Texture::get_copy_regions(VkImageAspectFlags aspect_flags) {
+    std::vector<VkBufferImageCopy> regions(header.mip_levels);
+    for (uint32_t level=0; level<header.mip_levels; level++) {
+        VkBufferImageCopy& region = regions[level];
+        region.bufferOffset = level_offsets[level];
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+
+        region.imageSubresource.aspectMask = aspect_flags;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = header.array_layers;
+
+        // Partial blocks at the edges are allowed as long as the extent reaches the edge of the mip level
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {std::max(header.width >> level, 1u), std::max(header.height >> level, 1u), 1};
+    }
+    return regions;
+}
\ No newline at end of file
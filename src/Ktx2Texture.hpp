@@ -0,0 +1,53 @@
+#ifndef KTX2_TEXTURE_HPP
+#define KTX2_TEXTURE_HPP
+
+#include <QVulkanInstance>
+#include <QString>
+#include <QByteArray>
+
+#include <vector>
+
+#include "VulkanFunctions.hpp"
+
+// 2D texture (or texture array) read from a KTX2 container with pre-baked mip levels
+// Only containers without supercompression & with a known `vkFormat` are supported (no Basis Universal transcoding)
+// The level data is kept as one blob so it can be uploaded with a single staging copy
+class Ktx2Texture {
+public:
+    struct Header {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t array_layers = 1;
+        uint32_t mip_levels = 1; // Stored in the file
+        // The file has a level count of 0: only the first level is stored & the others should be generated
+        bool generate_mip_levels = false;
+    };
+
+    // Reads the whole file. Returns false (and warns) if it isn't a supported KTX2 file
+    bool load(const QString& path);
+
+    // Reads only the header of `path`
+    static bool read_header(const QString& path, Header& header);
+    // True if `format` can be sampled with linear filtering & copied into on the device
+    // Block-compressed formats also need the matching `textureCompression*` feature to be enabled
+    static bool is_format_supported(VulkanData vkd, const VkPhysicalDeviceFeatures& enabled_features, VkFormat format);
+    static bool is_block_compressed(VkFormat format);
+
+    const Header& get_header() {return header;}
+    // Every mip level & layer, tightly packed
+    const char* get_level_data() {return level_data.constData();}
+    VkDeviceSize get_level_data_size() {return level_data.size();}
+    // One region per mip level (covering all layers) with buffer offsets relative to `get_level_data()`
+    std::vector<VkBufferImageCopy> get_copy_regions(VkImageAspectFlags aspect_flags=VK_IMAGE_ASPECT_COLOR_BIT);
+
+private:
+    // Parses the header & level index at the start of `data`
+    static bool parse_header(const QByteArray& data, const QString& path, Header& header);
+
+    Header header{};
+    QByteArray level_data;
+    std::vector<VkDeviceSize> level_offsets; // Into `level_data`
+};
+
+#endif
@@ -0,0 +1,346 @@
+#include "MemoryAllocator.hpp"
+
+#include <QDebug>
+
+#include <algorithm>
+
+namespace {
+    uint32_t order_for_size(VkDeviceSize size) {
+        uint32_t order = 0;
+        while ((MemoryAllocator::min_node_size << order) < size)
+            order++;
+        return order;
+    }
+
+    VkDeviceSize floor_power_of_two(VkDeviceSize size) {
+        VkDeviceSize power = 1;
+        while (power <= size / 2)
+            power <<= 1;
+        return power;
+    }
+}
+
+VkResult MemoryAllocator::create(VulkanData vkd, VkDeviceSize preferred_block_size) {
+    this->vkd = vkd;
+
+    vkd.vkf->vkGetPhysicalDeviceMemoryProperties(vkd.physical_device, &memory_properties);
+
+    VkPhysicalDeviceProperties pdp;
+    vkd.vkf->vkGetPhysicalDeviceProperties(vkd.physical_device, &pdp);
+    max_allocation_count = pdp.limits.maxMemoryAllocationCount;
+    non_coherent_atom_size = std::max(pdp.limits.nonCoherentAtomSize, VkDeviceSize(1));
+
+    // Small heaps (e.g. the 256MiB device-local host-visible heap) get smaller blocks so a single block can't hog them
+    preferred_block_size = floor_power_of_two(std::max(preferred_block_size, min_node_size));
+    block_sizes.resize(memory_properties.memoryTypeCount);
+    for (uint32_t i=0; i<memory_properties.memoryTypeCount; i++) {
+        VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[i].heapIndex].size;
+        block_sizes[i] = std::max(std::min(preferred_block_size, floor_power_of_two(heap_size / 8)), min_node_size);
+    }
+
+    return VK_SUCCESS;
+}
+
+void MemoryAllocator::destroy() {
+    if (vkd.vkdf == nullptr)
+        return;
+
+    if (allocation_count != 0)
+        qWarning("MemoryAllocator: %u allocations were not freed before destroying the allocator", allocation_count);
+
+    for (auto& block : blocks) {
+        if (block->mapped != nullptr)
+            vkd.vkdf->vkUnmapMemory(vkd.device, block->memory);
+        vkd.vkdf->vkFreeMemory(vkd.device, block->memory, nullptr);
+    }
+    blocks.clear();
+    block_sizes.clear();
+
+    dedicated_count = 0;
+    allocation_count = 0;
+    dedicated_bytes = 0;
+    requested_bytes = 0;
+    used_bytes = 0;
+
+    vkd = VulkanData{};
+}
+
+VkResult MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, bool linear, Allocation& allocation) {
+    uint32_t type_filter = requirements.memoryTypeBits;
+    VkResult res = VK_ERROR_UNKNOWN;
+    while (true) {
+        uint32_t memory_type_index = find_memory_type(memory_properties, type_filter, required, preferred, requirements.size);
+        if (memory_type_index == uint32_t(-1))
+            break;
+
+        res = allocate_from_type(requirements, memory_type_index, linear, allocation);
+        if (res != VK_ERROR_OUT_OF_DEVICE_MEMORY && res != VK_ERROR_OUT_OF_HOST_MEMORY)
+            return res;
+        // E.g. the small resizable BAR heap is full, fall back to the next best type
+        type_filter &= ~(1u << memory_type_index);
+    }
+
+    if (res == VK_ERROR_UNKNOWN)
+        qWarning("MemoryAllocator: Failed to find suitable memory type index.");
+    else
+        qWarning("MemoryAllocator: Out of memory in every suitable memory type: %d", res);
+    return res;
+}
+
+VkResult MemoryAllocator::allocate_from_type(const VkMemoryRequirements& requirements, uint32_t memory_type_index, bool linear, Allocation& allocation) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Buddy nodes are aligned to their own size so the node only has to be big enough to cover the alignment
+    VkDeviceSize node_size = std::max(requirements.size, requirements.alignment);
+    if (node_size > block_sizes[memory_type_index] / 2)
+        return allocate_dedicated(requirements.size, memory_type_index, allocation);
+
+    uint32_t order = order_for_size(node_size);
+    VkDeviceSize offset = 0;
+
+    Block* block = nullptr;
+    for (auto& b : blocks) {
+        if (b->memory_type_index == memory_type_index && b->linear == linear && b->allocate(order, offset)) {
+            block = b.get();
+            break;
+        }
+    }
+    if (block == nullptr) {
+        block = create_block(memory_type_index, linear);
+        if (block == nullptr)
+            return allocate_dedicated(requirements.size, memory_type_index, allocation);
+        block->allocate(order, offset);
+    }
+
+    allocation.memory = block->memory;
+    allocation.offset = offset;
+    allocation.size = requirements.size;
+    allocation.mapped = block->mapped != nullptr ? static_cast<char*>(block->mapped) + offset : nullptr;
+    allocation.memory_type_index = memory_type_index;
+    allocation.memory_properties = memory_properties.memoryTypes[memory_type_index].propertyFlags;
+    allocation.block = block;
+    allocation.order = order;
+
+    allocation_count++;
+    requested_bytes += requirements.size;
+    used_bytes += min_node_size << order;
+
+    return VK_SUCCESS;
+}
+
+void MemoryAllocator::free(Allocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    allocation_count--;
+    requested_bytes -= allocation.size;
+
+    if (allocation.block == nullptr) {
+        // Freeing mapped memory implicitly unmaps it
+        vkd.vkdf->vkFreeMemory(vkd.device, allocation.memory, nullptr);
+        dedicated_count--;
+        dedicated_bytes -= allocation.size;
+        used_bytes -= allocation.size;
+    }
+    else {
+        Block* block = allocation.block;
+        block->free(allocation.offset, allocation.order);
+        used_bytes -= min_node_size << allocation.order;
+
+        // Keep one empty block per pool around so allocating & freeing a single resource doesn't thrash vkAllocateMemory
+        if (block->is_empty()) {
+            for (auto& b : blocks) {
+                if (b.get() != block && b->memory_type_index == block->memory_type_index && b->linear == block->linear) {
+                    destroy_block(block);
+                    break;
+                }
+            }
+        }
+    }
+
+    allocation = Allocation{};
+}
+
+VkResult MemoryAllocator::flush(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+    if (allocation.mapped == nullptr || allocation.is_coherent())
+        return VK_SUCCESS;
+    VkMappedMemoryRange range = get_atom_range(allocation, offset, size);
+    return vkd.vkdf->vkFlushMappedMemoryRanges(vkd.device, 1, &range);
+}
+
+VkResult MemoryAllocator::invalidate(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+    if (allocation.mapped == nullptr || allocation.is_coherent())
+        return VK_SUCCESS;
+    VkMappedMemoryRange range = get_atom_range(allocation, offset, size);
+    return vkd.vkdf->vkInvalidateMappedMemoryRanges(vkd.device, 1, &range);
+}
+
+VkMappedMemoryRange MemoryAllocator::get_atom_range(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+    if (size == VK_WHOLE_SIZE)
+        size = allocation.size - offset;
+
+    // Dedicated allocations are the whole device memory, blocks are a power of two (a multiple of the atom size)
+    VkDeviceSize memory_size = allocation.block != nullptr ? allocation.block->size : allocation.size;
+    VkDeviceSize begin = allocation.offset + offset;
+    VkDeviceSize end = begin + size;
+    begin -= begin % non_coherent_atom_size;
+    end = align_to(end, non_coherent_atom_size);
+
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation.memory;
+    range.offset = begin;
+    range.size = end >= memory_size ? VK_WHOLE_SIZE : end - begin;
+    return range;
+}
+
+MemoryAllocator::Stats MemoryAllocator::get_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Stats stats{};
+    stats.block_count = blocks.size();
+    stats.dedicated_count = dedicated_count;
+    stats.device_memory_count = stats.block_count + stats.dedicated_count;
+    stats.allocation_count = allocation_count;
+    stats.reserved_bytes = dedicated_bytes;
+    stats.requested_bytes = requested_bytes;
+    stats.used_bytes = used_bytes;
+
+    for (auto& block : blocks) {
+        stats.reserved_bytes += block->size;
+        stats.free_bytes += block->free_bytes;
+        stats.largest_free_range = std::max(stats.largest_free_range, block->largest_free_range());
+    }
+    return stats;
+}
+
+MemoryAllocator::Block* MemoryAllocator::create_block(uint32_t memory_type_index, bool linear) {
+    if (max_allocation_count != 0 && blocks.size() + dedicated_count >= max_allocation_count) {
+        qWarning("MemoryAllocator: Reached maxMemoryAllocationCount (%u)", max_allocation_count);
+        return nullptr;
+    }
+
+    auto block = std::make_unique<Block>();
+    block->size = block_sizes[memory_type_index];
+    block->memory_type_index = memory_type_index;
+    block->linear = linear;
+
+    VkMemoryAllocateInfo allocation_info{};
+    allocation_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocation_info.allocationSize = block->size;
+    allocation_info.memoryTypeIndex = memory_type_index;
+
+    VkResult res = vkd.vkdf->vkAllocateMemory(vkd.device, &allocation_info, nullptr, &block->memory);
+    if (res != VK_SUCCESS) {
+        qWarning("MemoryAllocator: Failed to allocate memory block: %d", res);
+        return nullptr;
+    }
+
+    if (memory_properties.memoryTypes[memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        res = vkd.vkdf->vkMapMemory(vkd.device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+        if (res != VK_SUCCESS)
+            qWarning("MemoryAllocator: Failed to map memory block: %d", res);
+    }
+
+    uint32_t max_order = order_for_size(block->size);
+    block->free_lists.resize(max_order + 1);
+    block->free_lists[max_order].insert(0);
+    block->free_bytes = block->size;
+
+    blocks.push_back(std::move(block));
+    return blocks.back().get();
+}
+
+void MemoryAllocator::destroy_block(Block* block) {
+    auto it = std::find_if(blocks.begin(), blocks.end(), [block](const std::unique_ptr<Block>& b){return b.get() == block;});
+    if (it == blocks.end())
+        return;
+
+    if (block->mapped != nullptr)
+        vkd.vkdf->vkUnmapMemory(vkd.device, block->memory);
+    vkd.vkdf->vkFreeMemory(vkd.device, block->memory, nullptr);
+    blocks.erase(it);
+}
+
+VkResult MemoryAllocator::allocate_dedicated(VkDeviceSize size, uint32_t memory_type_index, Allocation& allocation) {
+    if (max_allocation_count != 0 && blocks.size() + dedicated_count >= max_allocation_count)
+        qWarning("MemoryAllocator: Exceeding maxMemoryAllocationCount (%u)", max_allocation_count);
+
+    VkMemoryAllocateInfo allocation_info{};
+    allocation_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocation_info.allocationSize = size;
+    allocation_info.memoryTypeIndex = memory_type_index;
+
+    allocation = Allocation{};
+    VkResult res = vkd.vkdf->vkAllocateMemory(vkd.device, &allocation_info, nullptr, &allocation.memory);
+    if (res != VK_SUCCESS)
+        return res;
+
+    if (memory_properties.memoryTypes[memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        res = vkd.vkdf->vkMapMemory(vkd.device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped);
+        if (res != VK_SUCCESS)
+            qWarning("MemoryAllocator: Failed to map dedicated allocation: %d", res);
+    }
+
+    allocation.size = size;
+    allocation.memory_type_index = memory_type_index;
+    allocation.memory_properties = memory_properties.memoryTypes[memory_type_index].propertyFlags;
+
+    dedicated_count++;
+    allocation_count++;
+    dedicated_bytes += size;
+    requested_bytes += size;
+    used_bytes += size;
+
+    return VK_SUCCESS;
+}
+
+
+// Block
+//======
+
+bool MemoryAllocator::Block::allocate(uint32_t order, VkDeviceSize& offset) {
+    uint32_t current_order = order;
+    while (current_order < free_lists.size() && free_lists[current_order].empty())
+        current_order++;
+    if (current_order >= free_lists.size())
+        return false;
+
+    offset = *free_lists[current_order].begin();
+    free_lists[current_order].erase(free_lists[current_order].begin());
+
+    // Split the node until it's the requested size, keeping the lower half each time
+    while (current_order > order) {
+        current_order--;
+        free_lists[current_order].insert(offset + (min_node_size << current_order));
+    }
+
+    free_bytes -= min_node_size << order;
+    return true;
+}
+
+void MemoryAllocator::Block::free(VkDeviceSize offset, uint32_t order) {
+    free_bytes += min_node_size << order;
+
+    // Merge with the buddy for as long as it is free
+    while (order + 1 < free_lists.size()) {
+        VkDeviceSize buddy = offset ^ (min_node_size << order);
+        auto it = free_lists[order].find(buddy);
+        if (it == free_lists[order].end())
+            break;
+        free_lists[order].erase(it);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    free_lists[order].insert(offset);
+}
+
+VkDeviceSize MemoryAllocator::Block::largest_free_range() {
+    for (size_t order=free_lists.size(); order>0; order--) {
+        if (!free_lists[order-1].empty())
+            return min_node_size << (order-1);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#ifndef MEMORY_ALLOCATOR_HPP
+#define MEMORY_ALLOCATOR_HPP
+
+#include <QVulkanInstance>
+
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+
+#include "VulkanFunctions.hpp"
+
+// Sub-allocates device memory out of large per-memory-type blocks using a buddy allocator
+// Buffers and linear images are kept in different blocks than optimal images so `bufferImageGranularity` never has to be considered
+// Allocations too large for a block get their own (dedicated) VkDeviceMemory
+// Host-visible blocks are persistently mapped; `Allocation::mapped` points to the start of the allocation
+// Writes to & reads from non-coherent memory have to be made visible with `flush` & `invalidate`
+// Warning: `destroy` will not be called on destructor. It must explicitly be called after `create`
+class MemoryAllocator {
+public:
+    struct Block;
+
+    struct Allocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0; // Requested size (the reserved size might be larger)
+        void* mapped = nullptr; // Only valid for host-visible memory
+
+        uint32_t memory_type_index = uint32_t(-1);
+        VkMemoryPropertyFlags memory_properties = 0; // Of the memory type
+        Block* block = nullptr; // nullptr for dedicated allocations
+        uint32_t order = 0;
+
+        bool is_coherent() const {return memory_properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;}
+    };
+
+    struct Stats {
+        uint32_t device_memory_count = 0; // Number of live `vkAllocateMemory` allocations (blocks + dedicated)
+        uint32_t block_count = 0;
+        uint32_t dedicated_count = 0;
+        uint32_t allocation_count = 0; // Number of live allocations handed out (including dedicated)
+
+        VkDeviceSize reserved_bytes = 0; // Device memory owned by the allocator
+        VkDeviceSize requested_bytes = 0; // Sum of the sizes requested by live allocations
+        VkDeviceSize used_bytes = 0; // Sum of the sizes actually reserved for live allocations
+        VkDeviceSize free_bytes = 0; // Free bytes inside blocks
+        VkDeviceSize largest_free_range = 0;
+
+        // Memory lost to rounding allocations up to a power of two (0 = none)
+        float internal_fragmentation() const {return used_bytes == 0 ? 0.0f : 1.0f - float(requested_bytes)/float(used_bytes);}
+        // How much the free memory is split into small ranges (0 = all free memory is one range)
+        float external_fragmentation() const {return free_bytes == 0 ? 0.0f : 1.0f - float(largest_free_range)/float(free_bytes);}
+    };
+
+    static constexpr VkDeviceSize default_block_size = 64 * 1024 * 1024;
+    static constexpr VkDeviceSize min_node_size = 256;
+
+    VkResult create(VulkanData vkd, VkDeviceSize preferred_block_size=default_block_size);
+    void destroy();
+
+    // The memory type is chosen by `find_memory_type` with `required` & `preferred` properties. If its heap is out of
+    // memory the next best type is tried
+    // `linear` should be true for buffers & linear images and false for optimal images
+    VkResult allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, bool linear, Allocation& allocation);
+    void free(Allocation& allocation);
+
+    // Make host writes to [`offset`, `offset`+`size`) of the allocation visible to the device / device writes visible to the host
+    // The range is widened to `nonCoherentAtomSize`. Nothing is done for coherent memory
+    VkResult flush(const Allocation& allocation, VkDeviceSize offset=0, VkDeviceSize size=VK_WHOLE_SIZE);
+    VkResult invalidate(const Allocation& allocation, VkDeviceSize offset=0, VkDeviceSize size=VK_WHOLE_SIZE);
+
+    Stats get_stats();
+
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;
+
+        uint32_t memory_type_index = uint32_t(-1);
+        bool linear = true;
+
+        // free_lists[order] contains the offsets of free nodes of size `min_node_size << order`
+        std::vector<std::set<VkDeviceSize>> free_lists;
+        VkDeviceSize free_bytes = 0;
+
+        bool allocate(uint32_t order, VkDeviceSize& offset);
+        void free(VkDeviceSize offset, uint32_t order);
+        bool is_empty() {return free_bytes == size;}
+        VkDeviceSize largest_free_range();
+    };
+
+private:
+    VulkanData vkd{};
+    VkPhysicalDeviceMemoryProperties memory_properties{};
+    uint32_t max_allocation_count = 0;
+    VkDeviceSize non_coherent_atom_size = 1;
+
+    // Indexed by memory type index
+    std::vector<VkDeviceSize> block_sizes;
+
+    std::vector<std::unique_ptr<Block>> blocks;
+    Block* create_block(uint32_t memory_type_index, bool linear);
+    void destroy_block(Block* block);
+
+    VkResult allocate_from_type(const VkMemoryRequirements& requirements, uint32_t memory_type_index, bool linear, Allocation& allocation);
+    VkResult allocate_dedicated(VkDeviceSize size, uint32_t memory_type_index, Allocation& allocation);
+    // Range of `allocation` widened to whole atoms (within its device memory)
+    VkMappedMemoryRange get_atom_range(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+
+    uint32_t dedicated_count = 0;
+    uint32_t allocation_count = 0;
+    VkDeviceSize dedicated_bytes = 0;
+    VkDeviceSize requested_bytes = 0;
+    VkDeviceSize used_bytes = 0;
+
+    std::mutex mutex;
+};
+
+#endif
\ No newline at end of file
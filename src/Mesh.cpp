@@ -0,0 +1,302 @@
+#include "Mesh.hpp"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDebug>
+
+#include <unordered_map>
+#include <cstring>
+#include <cstdlib>
+
+namespace {
+    // glTF accessor component types
+    const int gltf_unsigned_byte = 5121;
+    const int gltf_unsigned_short = 5123;
+    const int gltf_unsigned_int = 5125;
+    const int gltf_float = 5126;
+    const int gltf_triangles = 4;
+
+    const uint32_t glb_magic = 0x46546C67; // "glTF"
+    const uint32_t glb_json_chunk = 0x4E4F534A; // "JSON"
+    const uint32_t glb_binary_chunk = 0x004E4942; // "BIN\0"
+
+    // Resolves 1-based (or negative, relative) OBJ indices. Returns -1 if out of range
+    int obj_index(const char* token, int count) {
+        int index = atoi(token);
+        if (index < 0)
+            index += count;
+        else
+            index -= 1;
+        return (index >= 0 && index < count) ? index : -1;
+    }
+}
+
+bool Mesh::load(const QString& path) {
+    vertices.clear();
+    indices.clear();
+
+    bool loaded;
+    if (path.endsWith(".obj", Qt::CaseInsensitive)) {
+        loaded = load_obj(path);
+    }
+    else if (path.endsWith(".gltf", Qt::CaseInsensitive) || path.endsWith(".glb", Qt::CaseInsensitive)) {
+        loaded = load_gltf(path);
+    }
+    else {
+        qWarning("Mesh: Unknown mesh format %s", qPrintable(path));
+        loaded = false;
+    }
+
+    if (!loaded || indices.empty()) {
+        vertices.clear();
+        indices.clear();
+        return false;
+    }
+    return true;
+}
+
+bool Mesh::load_obj(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning("Mesh: Failed to open %s", qPrintable(path));
+        return false;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> colors;
+    std::vector<glm::vec2> tex_coords;
+    // (position, texture coordinate) pair to vertex index
+    std::unordered_map<uint64_t, Index> vertex_map;
+
+    std::vector<Index> polygon;
+    for (const QByteArray& line : data.split('\n')) {
+        QByteArray trimmed_line = line.trimmed();
+        const char* str = trimmed_line.constData();
+
+        if (strncmp(str, "v ", 2) == 0) {
+            glm::vec3 position(0.0f);
+            glm::vec3 color(1.0f);
+            int n = sscanf(str + 2, "%f %f %f %f %f %f", &position.x, &position.y, &position.z, &color.x, &color.y, &color.z);
+            positions.push_back(position);
+            colors.push_back(n == 6 ? color : glm::vec3(1.0f));
+        }
+        else if (strncmp(str, "vt ", 3) == 0) {
+            glm::vec2 tex_coord(0.0f);
+            sscanf(str + 3, "%f %f", &tex_coord.x, &tex_coord.y);
+            // OBJ has the origin at the bottom left
+            tex_coord.y = 1.0f - tex_coord.y;
+            tex_coords.push_back(tex_coord);
+        }
+        else if (strncmp(str, "f ", 2) == 0) {
+            polygon.clear();
+            for (const QByteArray& corner : trimmed_line.mid(2).simplified().split(' ')) {
+                QList<QByteArray> corner_indices = corner.split('/');
+                int position_index = obj_index(corner_indices[0].constData(), positions.size());
+                int tex_coord_index = (corner_indices.size() > 1 && !corner_indices[1].isEmpty())
+                    ? obj_index(corner_indices[1].constData(), tex_coords.size()) : -1;
+                if (position_index == -1) {
+                    qWarning("Mesh: Invalid face in %s", qPrintable(path));
+                    return false;
+                }
+
+                uint64_t key = (uint64_t(position_index) << 32) | uint32_t(tex_coord_index);
+                auto it = vertex_map.find(key);
+                if (it == vertex_map.end()) {
+                    Vertex vertex{};
+                    vertex.position = positions[position_index];
+                    vertex.color = colors[position_index];
+                    vertex.tex_coord = tex_coord_index != -1 ? tex_coords[tex_coord_index] : glm::vec2(0.0f);
+                    it = vertex_map.emplace(key, Index(vertices.size())).first;
+                    vertices.push_back(vertex);
+                }
+                polygon.push_back(it->second);
+            }
+
+            for (size_t i=2; i<polygon.size(); i++) {
+                indices.push_back(polygon[0]);
+                indices.push_back(polygon[i-1]);
+                indices.push_back(polygon[i]);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool Mesh::load_gltf(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning("Mesh: Failed to open %s", qPrintable(path));
+        return false;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+
+    if (!path.endsWith(".glb", Qt::CaseInsensitive))
+        return load_gltf_json(path, data, QByteArray());
+
+    // Binary container: 12 byte header followed by a JSON chunk and an optional binary chunk
+    uint32_t header[3];
+    if (size_t(data.size()) < sizeof(header) + 8) {
+        qWarning("Mesh: %s is truncated", qPrintable(path));
+        return false;
+    }
+    memcpy(header, data.constData(), sizeof(header));
+    if (header[0] != glb_magic || header[1] != 2) {
+        qWarning("Mesh: %s is not a glTF 2.0 binary", qPrintable(path));
+        return false;
+    }
+
+    QByteArray json;
+    QByteArray binary_chunk;
+    size_t offset = sizeof(header);
+    while (offset + 8 <= size_t(data.size())) {
+        uint32_t chunk_header[2];
+        memcpy(chunk_header, data.constData() + offset, sizeof(chunk_header));
+        offset += sizeof(chunk_header);
+        if (offset + chunk_header[0] > size_t(data.size()))
+            break;
+
+        if (chunk_header[1] == glb_json_chunk)
+            json = data.mid(offset, chunk_header[0]);
+        else if (chunk_header[1] == glb_binary_chunk)
+            binary_chunk = data.mid(offset, chunk_header[0]);
+        offset += chunk_header[0];
+    }
+
+    return load_gltf_json(path, json, binary_chunk);
+}
+
+bool Mesh::load_gltf_json(const QString& path, const QByteArray& json, const QByteArray& binary_chunk) {
+    QJsonDocument document = QJsonDocument::fromJson(json);
+    if (!document.isObject()) {
+        qWarning("Mesh: %s has invalid JSON", qPrintable(path));
+        return false;
+    }
+    QJsonObject root = document.object();
+
+    // Buffers are either the .glb binary chunk, base64 data URIs or files next to the .gltf
+    std::vector<QByteArray> buffers;
+    for (const QJsonValue& buffer_value : root["buffers"].toArray()) {
+        QString uri = buffer_value.toObject()["uri"].toString();
+        if (uri.isEmpty()) {
+            buffers.push_back(binary_chunk);
+        }
+        else if (uri.startsWith("data:")) {
+            buffers.push_back(QByteArray::fromBase64(uri.mid(uri.indexOf(',') + 1).toLatin1()));
+        }
+        else {
+            QFile buffer_file(QFileInfo(path).dir().filePath(uri));
+            if (!buffer_file.open(QIODevice::ReadOnly)) {
+                qWarning("Mesh: Failed to open buffer %s of %s", qPrintable(uri), qPrintable(path));
+                return false;
+            }
+            buffers.push_back(buffer_file.readAll());
+        }
+    }
+
+    const QJsonArray buffer_views = root["bufferViews"].toArray();
+    const QJsonArray accessors = root["accessors"].toArray();
+
+    // Calls `element(i, component_type, data)` for every element of `accessor_index` after validating it
+    // Accessors without a buffer view (sparse or all zeros) aren't supported
+    auto read_accessor = [&](int accessor_index, int expected_components, auto element) -> bool {
+        if (accessor_index < 0 || accessor_index >= accessors.size())
+            return false;
+        QJsonObject accessor = accessors.at(accessor_index).toObject();
+        int buffer_view_index = accessor["bufferView"].toInt(-1);
+        if (buffer_view_index < 0 || buffer_view_index >= buffer_views.size())
+            return false;
+        QJsonObject buffer_view = buffer_views.at(buffer_view_index).toObject();
+        int buffer_index = buffer_view["buffer"].toInt();
+        if (buffer_index < 0 || buffer_index >= int(buffers.size()))
+            return false;
+        const QByteArray& buffer = buffers[buffer_index];
+
+        int component_type = accessor["componentType"].toInt();
+        int component_size = component_type == gltf_unsigned_byte ? 1 : component_type == gltf_unsigned_short ? 2 : 4;
+        int element_size = component_size * expected_components;
+        int stride = buffer_view["byteStride"].toInt(element_size);
+        int offset = buffer_view["byteOffset"].toInt() + accessor["byteOffset"].toInt();
+        int count = accessor["count"].toInt();
+        if (count > 0 && offset + (count-1)*stride + element_size > buffer.size())
+            return false;
+
+        for (int i=0; i<count; i++)
+            element(i, component_type, buffer.constData() + offset + i*stride);
+        return true;
+    };
+
+    for (const QJsonValue& mesh_value : root["meshes"].toArray()) {
+        for (const QJsonValue& primitive_value : mesh_value.toObject()["primitives"].toArray()) {
+            QJsonObject primitive = primitive_value.toObject();
+            if (primitive["mode"].toInt(gltf_triangles) != gltf_triangles)
+                continue;
+            QJsonObject attributes = primitive["attributes"].toObject();
+
+            int position_accessor = attributes["POSITION"].toInt(-1);
+            if (position_accessor < 0 || position_accessor >= accessors.size()) {
+                qWarning("Mesh: %s has invalid accessors", qPrintable(path));
+                return false;
+            }
+
+            Index base_vertex = vertices.size();
+            int vertex_count = accessors.at(position_accessor).toObject()["count"].toInt();
+            vertices.resize(base_vertex + vertex_count, Vertex{glm::vec3(0.0f), glm::vec3(1.0f), glm::vec2(0.0f)});
+            Vertex* primitive_vertices = vertices.data() + base_vertex;
+
+            bool valid = read_accessor(position_accessor, 3, [&](int i, int component_type, const char* data) {
+                if (component_type == gltf_float)
+                    memcpy(&primitive_vertices[i].position, data, sizeof(glm::vec3));
+            });
+            if (attributes.contains("TEXCOORD_0")) {
+                valid &= read_accessor(attributes["TEXCOORD_0"].toInt(), 2, [&](int i, int component_type, const char* data) {
+                    if (component_type == gltf_float && i < vertex_count)
+                        memcpy(&primitive_vertices[i].tex_coord, data, sizeof(glm::vec2));
+                });
+            }
+            if (attributes.contains("COLOR_0")) {
+                valid &= read_accessor(attributes["COLOR_0"].toInt(), 3, [&](int i, int component_type, const char* data) {
+                    if (component_type == gltf_float && i < vertex_count)
+                        memcpy(&primitive_vertices[i].color, data, sizeof(glm::vec3));
+                });
+            }
+
+            bool indices_in_range = true;
+            if (primitive.contains("indices")) {
+                valid &= read_accessor(primitive["indices"].toInt(), 1, [&](int, int component_type, const char* data) {
+                    uint32_t index = 0;
+                    if (component_type == gltf_unsigned_byte)
+                        index = *reinterpret_cast<const uint8_t*>(data);
+                    else if (component_type == gltf_unsigned_short)
+                        memcpy(&index, data, 2);
+                    else if (component_type == gltf_unsigned_int)
+                        memcpy(&index, data, 4);
+                    indices_in_range &= index < uint32_t(vertex_count);
+                    indices.push_back(base_vertex + index);
+                });
+            }
+            else {
+                for (int i=0; i<vertex_count; i++)
+                    indices.push_back(base_vertex + i);
+            }
+
+            if (!valid) {
+                qWarning("Mesh: %s has invalid accessors", qPrintable(path));
+                return false;
+            }
+            if (!indices_in_range) {
+                qWarning("Mesh: %s has indices outside of their primitive's vertices", qPrintable(path));
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef MESH_HPP
+#define MESH_HPP
+
+#include <QString>
+#include <QByteArray>
+
+#include <vector>
+
+#include "Vertex.hpp"
+
+// Indexed triangle list loaded from an OBJ or glTF (.gltf/.glb) file
+// OBJ: positions, texture coordinates & (non-standard) vertex colors. Polygons are triangulated as fans
+// glTF: POSITION, TEXCOORD_0 & COLOR_0 of every triangle primitive. Node transforms are ignored
+// Attributes a file doesn't have are left at white / (0,0)
+class Mesh {
+public:
+    std::vector<Vertex> vertices;
+    std::vector<Index> indices;
+
+    // Returns false (and warns) if the file couldn't be loaded. The mesh is left empty in that case
+    bool load(const QString& path);
+
+private:
+    bool load_obj(const QString& path);
+    bool load_gltf(const QString& path);
+    // `json` & `binary_chunk` are the two chunks of a .glb file (`binary_chunk` is empty for .gltf)
+    bool load_gltf_json(const QString& path, const QByteArray& json, const QByteArray& binary_chunk);
+};
+
+#endif
@@ -0,0 +1,262 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+namespace {
+    // Forsyth's scoring parameters, tuned for an LRU cache of 32 entries
+    const int lru_cache_size = 32;
+    const float last_triangle_score = 0.75f;
+    const float cache_decay_power = 1.5f;
+    const float valence_boost_scale = 2.0f;
+    const float valence_boost_power = 0.5f;
+
+    // FIFO cache size used to find cluster boundaries, close to what most hardware has
+    const uint32_t overdraw_cache_size = 16;
+
+    float vertex_score(int cache_position, uint32_t remaining_triangles) {
+        if (remaining_triangles == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        if (cache_position >= 0) {
+            // The vertices of the last triangle get a fixed score, so the next triangle doesn't reuse the same edge over & over
+            if (cache_position < 3)
+                score = last_triangle_score;
+            else
+                score = std::pow(1.0f - float(cache_position - 3) / (lru_cache_size - 3), cache_decay_power);
+        }
+        // Prefer vertices with few triangles left so they can leave the cache for good
+        return score + valence_boost_scale * std::pow(float(remaining_triangles), -valence_boost_power);
+    }
+}
+
+MeshOptimizer::VertexCacheStats MeshOptimizer::analyze_vertex_cache(const std::vector<Index>& indices, size_t vertex_count, uint32_t cache_size) {
+    // A vertex is in the FIFO cache if fewer than `cache_size` misses happened since it was loaded
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    uint32_t time = cache_size + 1;
+    uint32_t unique_vertices = 0;
+
+    VertexCacheStats stats{};
+    for (Index index : indices) {
+        if (timestamps[index] == 0)
+            unique_vertices++;
+        if (time - timestamps[index] > cache_size) {
+            timestamps[index] = time++;
+            stats.vs_invocations++;
+        }
+    }
+
+    stats.acmr = indices.empty() ? 0.0f : float(stats.vs_invocations) / (indices.size() / 3);
+    stats.atvr = unique_vertices == 0 ? 0.0f : float(stats.vs_invocations) / unique_vertices;
+    return stats;
+}
+
+void MeshOptimizer::optimize_vertex_cache(std::vector<Index>& indices, size_t vertex_count) {
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0)
+        return;
+
+    // Triangles using each vertex. The first `remaining_triangles[v]` entries of a vertex are the ones not emitted yet
+    std::vector<uint32_t> remaining_triangles(vertex_count, 0);
+    for (Index index : indices)
+        remaining_triangles[index]++;
+    std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+    std::partial_sum(remaining_triangles.begin(), remaining_triangles.end(), adjacency_offsets.begin() + 1);
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill = adjacency_offsets;
+        for (size_t i=0; i<indices.size(); i++)
+            adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<int> cache_positions(vertex_count, -1);
+    std::vector<float> vertex_scores(vertex_count);
+    for (size_t v=0; v<vertex_count; v++)
+        vertex_scores[v] = vertex_score(-1, remaining_triangles[v]);
+
+    std::vector<float> triangle_scores(triangle_count);
+    std::vector<bool> emitted(triangle_count, false);
+    for (size_t t=0; t<triangle_count; t++)
+        triangle_scores[t] = vertex_scores[indices[t*3]] + vertex_scores[indices[t*3+1]] + vertex_scores[indices[t*3+2]];
+
+    std::vector<Index> result;
+    result.reserve(indices.size());
+    std::vector<Index> cache;
+    std::vector<Index> new_cache;
+    cache.reserve(lru_cache_size + 3);
+    new_cache.reserve(lru_cache_size + 3);
+
+    size_t best_triangle = std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin();
+    size_t next_unemitted = 0;
+    while (result.size() < indices.size()) {
+        const Index* triangle = &indices[best_triangle*3];
+        emitted[best_triangle] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        for (int i=0; i<3; i++) {
+            Index v = triangle[i];
+            uint32_t* triangles = &adjacency[adjacency_offsets[v]];
+            uint32_t* it = std::find(triangles, triangles + remaining_triangles[v], best_triangle);
+            std::swap(*it, triangles[remaining_triangles[v] - 1]);
+            remaining_triangles[v]--;
+        }
+
+        // The emitted triangle's vertices move to the front of the LRU cache
+        new_cache.assign(triangle, triangle + 3);
+        for (Index v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                new_cache.push_back(v);
+        }
+        for (size_t i=0; i<new_cache.size(); i++) {
+            Index v = new_cache[i];
+            cache_positions[v] = i < size_t(lru_cache_size) ? int(i) : -1;
+            vertex_scores[v] = vertex_score(cache_positions[v], remaining_triangles[v]);
+        }
+
+        // Only triangles touching the cache changed their score, the best one of them is emitted next
+        float best_score = -1.0f;
+        bool found = false;
+        for (Index v : new_cache) {
+            for (uint32_t i=0; i<remaining_triangles[v]; i++) {
+                uint32_t t = adjacency[adjacency_offsets[v] + i];
+                float score = vertex_scores[indices[t*3]] + vertex_scores[indices[t*3+1]] + vertex_scores[indices[t*3+2]];
+                triangle_scores[t] = score;
+                if (cache_positions[v] >= 0 && score > best_score) {
+                    best_score = score;
+                    best_triangle = t;
+                    found = true;
+                }
+            }
+        }
+
+        new_cache.resize(std::min(new_cache.size(), size_t(lru_cache_size)));
+        std::swap(cache, new_cache);
+
+        // Dead end: continue with the next triangle in the original order, which keeps this linear
+        if (!found) {
+            while (next_unemitted < triangle_count && emitted[next_unemitted])
+                next_unemitted++;
+            best_triangle = next_unemitted;
+        }
+    }
+
+    indices = std::move(result);
+}
+
+void MeshOptimizer::optimize_overdraw(std::vector<Index>& indices, const std::vector<Vertex>& vertices, float threshold) {
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0)
+        return;
+
+    std::vector<uint32_t> timestamps(vertices.size(), 0);
+    uint32_t time = overdraw_cache_size + 1;
+    auto simulate_triangle = [&](size_t t) {
+        uint32_t misses = 0;
+        for (int i=0; i<3; i++) {
+            Index v = indices[t*3+i];
+            if (time - timestamps[v] > overdraw_cache_size) {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+
+    // Hard boundaries: triangles missing the cache completely, splitting there doesn't cost anything
+    std::vector<uint32_t> triangle_misses(triangle_count);
+    std::vector<size_t> hard_boundaries;
+    for (size_t t=0; t<triangle_count; t++) {
+        triangle_misses[t] = simulate_triangle(t);
+        if (t == 0 || triangle_misses[t] == 3)
+            hard_boundaries.push_back(t);
+    }
+    hard_boundaries.push_back(triangle_count);
+
+    // Soft boundaries: split a cluster further once its ACMR (starting with a cold cache) is within `threshold` of the whole cluster's
+    std::vector<size_t> clusters;
+    for (size_t i=0; i+1<hard_boundaries.size(); i++) {
+        size_t start = hard_boundaries[i];
+        size_t end = hard_boundaries[i+1];
+        uint32_t cluster_misses = std::accumulate(triangle_misses.begin() + start, triangle_misses.begin() + end, 0u);
+        float cluster_threshold = threshold * cluster_misses / (end - start);
+
+        clusters.push_back(start);
+        time += overdraw_cache_size + 1;
+        size_t sub_start = start;
+        uint32_t sub_misses = 0;
+        for (size_t t=start; t<end; t++) {
+            sub_misses += simulate_triangle(t);
+            if (t + 1 < end && float(sub_misses) / (t - sub_start + 1) <= cluster_threshold) {
+                clusters.push_back(t + 1);
+                sub_start = t + 1;
+                sub_misses = 0;
+                time += overdraw_cache_size + 1;
+            }
+        }
+    }
+    clusters.push_back(triangle_count);
+
+    // Sort clusters by how much they face away from the mesh's center, those are likely to occlude the rest
+    size_t cluster_count = clusters.size() - 1;
+    std::vector<glm::vec3> cluster_centroids(cluster_count, glm::vec3(0.0f));
+    std::vector<glm::vec3> cluster_normals(cluster_count, glm::vec3(0.0f));
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+    for (size_t c=0; c<cluster_count; c++) {
+        float cluster_area = 0.0f;
+        for (size_t t=clusters[c]; t<clusters[c+1]; t++) {
+            const glm::vec3& p0 = vertices[indices[t*3]].position;
+            const glm::vec3& p1 = vertices[indices[t*3+1]].position;
+            const glm::vec3& p2 = vertices[indices[t*3+2]].position;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+
+            cluster_centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+            cluster_normals[c] += normal;
+            cluster_area += area;
+        }
+        mesh_centroid += cluster_centroids[c];
+        mesh_area += cluster_area;
+        if (cluster_area > 0.0f)
+            cluster_centroids[c] /= cluster_area;
+    }
+    if (mesh_area > 0.0f)
+        mesh_centroid /= mesh_area;
+
+    std::vector<float> sort_keys(cluster_count);
+    for (size_t c=0; c<cluster_count; c++) {
+        float normal_length = glm::length(cluster_normals[c]);
+        sort_keys[c] = normal_length > 0.0f ? glm::dot(cluster_centroids[c] - mesh_centroid, cluster_normals[c] / normal_length) : 0.0f;
+    }
+
+    std::vector<size_t> order(cluster_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return sort_keys[a] > sort_keys[b];
+    });
+
+    std::vector<Index> result;
+    result.reserve(indices.size());
+    for (size_t c : order)
+        result.insert(result.end(), indices.begin() + clusters[c]*3, indices.begin() + clusters[c+1]*3);
+    indices = std::move(result);
+}
+
+void MeshOptimizer::optimize_vertex_fetch(std::vector<Index>& indices, std::vector<Vertex>& vertices) {
+    const Index unused = ~Index(0);
+    std::vector<Index> remap(vertices.size(), unused);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+
+    for (Index& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = result.size();
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(result);
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+
+#include <vector>
+
+#include "Vertex.hpp"
+
+// Load-time reordering of indexed triangle lists
+// Meant to be run in the order optimize_vertex_cache -> optimize_overdraw -> optimize_vertex_fetch,
+// each step only reorders what the previous ones don't depend on
+namespace MeshOptimizer {
+    struct VertexCacheStats {
+        // Average cache miss ratio: vertex shader invocations per triangle (0.5 is optimal for large grids, 3 is the worst)
+        float acmr;
+        // Average transform to vertex ratio: vertex shader invocations per unique vertex (1 is optimal)
+        float atvr;
+        uint32_t vs_invocations;
+    };
+
+    // Simulates a FIFO post-transform cache of `cache_size` entries. Actual hardware caches differ per vendor,
+    // so the results are an approximation useful for comparing index orders
+    VertexCacheStats analyze_vertex_cache(const std::vector<Index>& indices, size_t vertex_count, uint32_t cache_size=16);
+
+    // Reorders triangles for the post-transform vertex cache (Forsyth's linear-speed algorithm with an LRU cache of 32)
+    void optimize_vertex_cache(std::vector<Index>& indices, size_t vertex_count);
+
+    // Reorders clusters of triangles so that the outer ones are drawn first (Sander et al., "Fast triangle reordering")
+    // Clusters are cut where the cache misses of `optimize_vertex_cache`'s order allow it, increasing the ACMR by at most `threshold`
+    void optimize_overdraw(std::vector<Index>& indices, const std::vector<Vertex>& vertices, float threshold=1.05f);
+
+    // Reorders vertices in the order they are first referenced & remaps the indices accordingly
+    // Unreferenced vertices are dropped
+    void optimize_vertex_fetch(std::vector<Index>& indices, std::vector<Vertex>& vertices);
+}
+
+#endif
\ No newline at end of file
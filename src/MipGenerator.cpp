@@ -0,0 +1,369 @@
+#include "MipGenerator.hpp"
+
+#include <QDebug>
+
+#include <vector>
+
+#include "Shader.hpp"
+
+VkResult MipGenerator::create(VulkanData vkd, VkPipelineCache pipeline_cache, bool storage_image_write_without_format) {
+    this->vkd = vkd;
+
+    VkSamplerCreateInfo sampler_info = Image::default_texture_sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+    VkResult res = vkd.vkdf->vkCreateSampler(vkd.device, &sampler_info, nullptr, &sampler);
+    if (res != VK_SUCCESS)
+        return res;
+
+    if (storage_image_write_without_format)
+        create_compute_pipeline(pipeline_cache);
+    if (compute_pipeline == VK_NULL_HANDLE)
+        qDebug() << "MipGenerator: Compute fallback unavailable, only formats supporting linear blits get mip chains";
+
+    return VK_SUCCESS;
+}
+
+void MipGenerator::destroy() {
+    if (vkd.vkdf == nullptr)
+        return;
+
+    vkd.vkdf->vkDestroyPipeline(vkd.device, compute_pipeline, nullptr);
+    compute_pipeline = VK_NULL_HANDLE;
+    vkd.vkdf->vkDestroyPipelineLayout(vkd.device, pipeline_layout, nullptr);
+    pipeline_layout = VK_NULL_HANDLE;
+    vkd.vkdf->vkDestroyDescriptorSetLayout(vkd.device, descriptor_set_layout, nullptr);
+    descriptor_set_layout = VK_NULL_HANDLE;
+    vkd.vkdf->vkDestroySampler(vkd.device, sampler, nullptr);
+    sampler = VK_NULL_HANDLE;
+
+    vkd = VulkanData{};
+}
+
+MipGenerator::Method MipGenerator::get_method(VkFormat format) {
+    VkFormatProperties properties;
+    vkd.vkf->vkGetPhysicalDeviceFormatProperties(vkd.physical_device, format, &properties);
+    VkFormatFeatureFlags features = properties.optimalTilingFeatures;
+
+    VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    if ((features & blit_features) == blit_features)
+        return Method::Blit;
+
+    VkFormatFeatureFlags compute_features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+    if (compute_pipeline != VK_NULL_HANDLE && (features & compute_features) == compute_features)
+        return Method::Compute;
+
+    return Method::None;
+}
+
+VkImageUsageFlags MipGenerator::get_required_usage(VkFormat format) {
+    switch (get_method(format)) {
+    case Method::Blit:
+        return VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    case Method::Compute:
+        return VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    default:
+        return 0;
+    }
+}
+
+bool MipGenerator::generate(VkCommandBuffer command_buffer, Image& image, VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    switch (get_method(image.get_image_data().format)) {
+    case Method::Blit:
+        blit(command_buffer, image, final_layout, dst_stage, dst_access);
+        return true;
+    case Method::Compute: {
+        VkResult res = dispatch(command_buffer, image, final_layout, dst_stage, dst_access);
+        if (res != VK_SUCCESS) {
+            qWarning("MipGenerator: Failed to create mip level descriptors: %d", res);
+            return false;
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+void MipGenerator::blit(VkCommandBuffer command_buffer, Image& image, VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    const Image::CreateData& image_data = image.get_image_data();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image.get_vk_image();
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange = image.get_subresource_range();
+    barrier.subresourceRange.levelCount = 1;
+
+    // Every level is blitted from the previous one, which then goes straight to `final_layout`
+    for (uint32_t level=1; level<image_data.mip_levels; level++) {
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkd.vkdf->vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier
+        );
+
+        VkExtent2D src_extent = image.get_mip_extent(level - 1);
+        VkExtent2D dst_extent = image.get_mip_extent(level);
+
+        VkImageBlit blit{};
+        blit.srcSubresource.aspectMask = image_data.aspect_flags;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = image_data.array_layers;
+        blit.srcOffsets[0] = {0, 0, 0};
+        blit.srcOffsets[1] = {int32_t(src_extent.width), int32_t(src_extent.height), 1};
+        blit.dstSubresource = blit.srcSubresource;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstOffsets[0] = {0, 0, 0};
+        blit.dstOffsets[1] = {int32_t(dst_extent.width), int32_t(dst_extent.height), 1};
+
+        vkd.vkdf->vkCmdBlitImage(
+            command_buffer,
+            image.get_vk_image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            image.get_vk_image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit,
+            VK_FILTER_LINEAR
+        );
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = final_layout;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = dst_access;
+        vkd.vkdf->vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier
+        );
+    }
+
+    // The last level was only written
+    barrier.subresourceRange.baseMipLevel = image_data.mip_levels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = final_layout;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dst_access;
+    vkd.vkdf->vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier
+    );
+}
+
+VkResult MipGenerator::dispatch(VkCommandBuffer command_buffer, Image& image, VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    const Image::CreateData& image_data = image.get_image_data();
+
+    std::vector<VkDescriptorSet> descriptor_sets;
+    VkResult res = create_mip_descriptors(image, descriptor_sets);
+    if (res != VK_SUCCESS)
+        return res;
+
+    // Everything stays in VK_IMAGE_LAYOUT_GENERAL while the levels are read & written
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image.get_vk_image();
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange = image.get_subresource_range();
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkd.vkdf->vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier
+    );
+
+    vkd.vkdf->vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline);
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    for (uint32_t level=1; level<image_data.mip_levels; level++) {
+        vkd.vkdf->vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_sets[level-1], 0, nullptr);
+
+        VkExtent2D extent = image.get_mip_extent(level);
+        vkd.vkdf->vkCmdDispatch(
+            command_buffer,
+            (extent.width + workgroup_size - 1) / workgroup_size,
+            (extent.height + workgroup_size - 1) / workgroup_size,
+            image_data.array_layers
+        );
+
+        // The next level reads this one
+        barrier.subresourceRange.baseMipLevel = level;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        vkd.vkdf->vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier
+        );
+    }
+
+    barrier.subresourceRange = image.get_subresource_range();
+    barrier.newLayout = final_layout;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = dst_access;
+    vkd.vkdf->vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dst_stage,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier
+    );
+
+    return VK_SUCCESS;
+}
+
+VkResult MipGenerator::create_mip_descriptors(Image& image, std::vector<VkDescriptorSet>& descriptor_sets) {
+    const Image::CreateData& image_data = image.get_image_data();
+    uint32_t nr_sets = image_data.mip_levels - 1;
+    if (nr_sets == 0)
+        return VK_SUCCESS;
+
+    // Left over from an earlier generation of the same image
+    for (VkImageView mip_view : image.mip_views)
+        vkd.vkdf->vkDestroyImageView(vkd.device, mip_view, nullptr);
+    image.mip_views.clear();
+    vkd.vkdf->vkDestroyDescriptorPool(vkd.device, image.mip_descriptor_pool, nullptr);
+    image.mip_descriptor_pool = VK_NULL_HANDLE;
+
+    VkResult res;
+
+    image.mip_views.resize(image_data.mip_levels, VK_NULL_HANDLE);
+    for (uint32_t level=0; level<image_data.mip_levels; level++) {
+        VkImageSubresourceRange subresource_range = image.get_subresource_range();
+        subresource_range.baseMipLevel = level;
+        subresource_range.levelCount = 1;
+        res = Image::create_view(vkd, image.get_vk_image(), VK_IMAGE_VIEW_TYPE_2D_ARRAY, image_data.format, subresource_range, image.mip_views[level]);
+        if (res != VK_SUCCESS)
+            return res;
+    }
+
+    VkDescriptorPoolSize pool_sizes[] = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nr_sets},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, nr_sets},
+    };
+
+    VkDescriptorPoolCreateInfo pool_create_info{};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_create_info.poolSizeCount = sizeof(pool_sizes)/sizeof(pool_sizes[0]);
+    pool_create_info.pPoolSizes = pool_sizes;
+    pool_create_info.maxSets = nr_sets;
+
+    res = vkd.vkdf->vkCreateDescriptorPool(vkd.device, &pool_create_info, nullptr, &image.mip_descriptor_pool);
+    if (res != VK_SUCCESS)
+        return res;
+
+    std::vector<VkDescriptorSetLayout> set_layouts(nr_sets, descriptor_set_layout);
+    VkDescriptorSetAllocateInfo allocation_info{};
+    allocation_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocation_info.descriptorPool = image.mip_descriptor_pool;
+    allocation_info.descriptorSetCount = nr_sets;
+    allocation_info.pSetLayouts = set_layouts.data();
+
+    descriptor_sets.resize(nr_sets);
+    res = vkd.vkdf->vkAllocateDescriptorSets(vkd.device, &allocation_info, descriptor_sets.data());
+    if (res != VK_SUCCESS)
+        return res;
+
+    std::vector<VkDescriptorImageInfo> image_infos(2*nr_sets);
+    std::vector<VkWriteDescriptorSet> descriptor_writes(2*nr_sets);
+    for (uint32_t i=0; i<nr_sets; i++) {
+        VkDescriptorImageInfo& src_info = image_infos[2*i];
+        src_info.sampler = sampler;
+        src_info.imageView = image.mip_views[i];
+        src_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo& dst_info = image_infos[2*i+1];
+        dst_info.imageView = image.mip_views[i+1];
+        dst_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        for (uint32_t binding=0; binding<2; binding++) {
+            VkWriteDescriptorSet& descriptor_write = descriptor_writes[2*i+binding];
+            descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptor_write.dstSet = descriptor_sets[i];
+            descriptor_write.dstBinding = binding;
+            descriptor_write.dstArrayElement = 0;
+            descriptor_write.descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            descriptor_write.descriptorCount = 1;
+            descriptor_write.pImageInfo = &image_infos[2*i+binding];
+        }
+    }
+    vkd.vkdf->vkUpdateDescriptorSets(vkd.device, descriptor_writes.size(), descriptor_writes.data(), 0, nullptr);
+
+    return VK_SUCCESS;
+}
+
+void MipGenerator::create_compute_pipeline(VkPipelineCache pipeline_cache) {
+    ShaderModule compute_shader_module(vkd.device, vkd.vkdf, "src/shaders/mip_downsample.spv");
+    if (compute_shader_module.vk_shader_module == VK_NULL_HANDLE)
+        return;
+
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = sizeof(bindings)/sizeof(bindings[0]);
+    layout_info.pBindings = bindings;
+
+    VkResult res = vkd.vkdf->vkCreateDescriptorSetLayout(vkd.device, &layout_info, nullptr, &descriptor_set_layout);
+    if (res != VK_SUCCESS) {
+        qWarning("MipGenerator: Failed to create descriptor set layout: %d", res);
+        return;
+    }
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &descriptor_set_layout;
+
+    res = vkd.vkdf->vkCreatePipelineLayout(vkd.device, &pipeline_layout_info, nullptr, &pipeline_layout);
+    if (res != VK_SUCCESS) {
+        qWarning("MipGenerator: Failed to create pipeline layout: %d", res);
+        return;
+    }
+
+    VkComputePipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage = compute_shader_module.get_create_info(VK_SHADER_STAGE_COMPUTE_BIT);
+    pipeline_info.layout = pipeline_layout;
+    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_info.basePipelineIndex = -1;
+
+    res = vkd.vkdf->vkCreateComputePipelines(vkd.device, pipeline_cache, 1, &pipeline_info, nullptr, &compute_pipeline);
+    if (res != VK_SUCCESS) {
+        qWarning("MipGenerator: Failed to create compute pipeline: %d", res);
+        compute_pipeline = VK_NULL_HANDLE;
+    }
+}
\ No newline at end of file
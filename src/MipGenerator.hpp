@@ -0,0 +1,52 @@
+#ifndef MIP_GENERATOR_HPP
+#define MIP_GENERATOR_HPP
+
+#include <QVulkanInstance>
+
+#include "VulkanFunctions.hpp"
+#include "Image.hpp"
+
+// Fills the mip chain of an image from its first mip level on the GPU
+// Uses linearly filtered blits where the format supports them and a compute shader box filter otherwise
+// The compute path needs the `shaderStorageImageWriteWithoutFormat` feature and a format usable as storage image
+// Has to be recorded on a queue supporting graphics (blits) or compute (fallback)
+// Warning: `destroy` will not be called on destructor. It must explicitly be called after `create`
+class MipGenerator {
+public:
+    enum class Method {
+        None,
+        Blit,
+        Compute,
+    };
+
+    VkResult create(VulkanData vkd, VkPipelineCache pipeline_cache, bool storage_image_write_without_format);
+    void destroy();
+
+    Method get_method(VkFormat format);
+    bool can_generate(VkFormat format) {return get_method(format) != Method::None;}
+    // Usage flags an image needs for its mip chain to be generated (in addition to what it is used for otherwise)
+    VkImageUsageFlags get_required_usage(VkFormat format);
+
+    // Every mip level & layer of `image` must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL with the first mip level written by a transfer
+    // Leaves the whole image in `final_layout`, synchronized with the first use described by `dst_stage` & `dst_access`
+    // Returns false (and records nothing) if the image's format supports neither method
+    bool generate(VkCommandBuffer command_buffer, Image& image, VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+
+private:
+    VulkanData vkd{};
+
+    void blit(VkCommandBuffer command_buffer, Image& image, VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+    VkResult dispatch(VkCommandBuffer command_buffer, Image& image, VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+    // Per mip level views & descriptor sets (stored in the image)
+    VkResult create_mip_descriptors(Image& image, std::vector<VkDescriptorSet>& descriptor_sets);
+
+    void create_compute_pipeline(VkPipelineCache pipeline_cache);
+    VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline compute_pipeline = VK_NULL_HANDLE; // VK_NULL_HANDLE if the compute path isn't available
+    VkSampler sampler = VK_NULL_HANDLE;
+
+    static constexpr uint32_t workgroup_size = 8;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "PipelineCache.hpp"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QDebug>
+
+#include <cstring>
+
+VkResult PipelineCache::create(VulkanData vkd, const QString& path) {
+    this->vkd = vkd;
+    this->path = path;
+    loaded_bytes = 0;
+
+    QByteArray data;
+    if (!path.isEmpty()) {
+        QFile file(path);
+        if (file.open(QIODevice::ReadOnly)) {
+            data = file.readAll();
+            file.close();
+
+            if (!is_compatible(data)) {
+                qDebug() << "PipelineCache: Ignoring" << path << "(created by a different device or driver)";
+                data.clear();
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.initialDataSize = data.size();
+    create_info.pInitialData = data.isEmpty() ? nullptr : data.constData();
+
+    VkResult res = vkd.vkdf->vkCreatePipelineCache(vkd.device, &create_info, nullptr, &pipeline_cache);
+    if (res != VK_SUCCESS && !data.isEmpty()) {
+        // Shouldn't happen after validation, but a corrupt cache must never prevent startup
+        qWarning("PipelineCache: Failed to create pipeline cache from file data: %d", res);
+        data.clear();
+        create_info.initialDataSize = 0;
+        create_info.pInitialData = nullptr;
+        res = vkd.vkdf->vkCreatePipelineCache(vkd.device, &create_info, nullptr, &pipeline_cache);
+    }
+    if (res != VK_SUCCESS)
+        return res;
+
+    loaded_bytes = data.size();
+    qDebug() << "PipelineCache: Loaded" << loaded_bytes << "bytes";
+    return VK_SUCCESS;
+}
+
+void PipelineCache::destroy() {
+    if (vkd.vkdf == nullptr)
+        return;
+
+    if (!path.isEmpty())
+        save();
+
+    vkd.vkdf->vkDestroyPipelineCache(vkd.device, pipeline_cache, nullptr);
+    pipeline_cache = VK_NULL_HANDLE;
+    loaded_bytes = 0;
+
+    vkd = VulkanData{};
+}
+
+bool PipelineCache::is_compatible(const QByteArray& data) {
+    // Layout of VkPipelineCacheHeaderVersionOne (written by the driver in little endian order of the host)
+    struct Header {
+        uint32_t header_size;
+        uint32_t header_version;
+        uint32_t vendor_id;
+        uint32_t device_id;
+        uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    };
+    static_assert(sizeof(Header) == 16 + VK_UUID_SIZE, "Unexpected pipeline cache header size");
+
+    if (size_t(data.size()) < sizeof(Header))
+        return false;
+
+    Header header;
+    memcpy(&header, data.constData(), sizeof(Header));
+
+    VkPhysicalDeviceProperties pdp;
+    vkd.vkf->vkGetPhysicalDeviceProperties(vkd.physical_device, &pdp);
+
+    return header.header_size >= sizeof(Header) &&
+           header.header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendor_id == pdp.vendorID &&
+           header.device_id == pdp.deviceID &&
+           memcmp(header.pipeline_cache_uuid, pdp.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::save() {
+    size_t size = 0;
+    VkResult res = vkd.vkdf->vkGetPipelineCacheData(vkd.device, pipeline_cache, &size, nullptr);
+    if (res != VK_SUCCESS || size == 0)
+        return;
+
+    QByteArray data(size, Qt::Uninitialized);
+    res = vkd.vkdf->vkGetPipelineCacheData(vkd.device, pipeline_cache, &size, data.data());
+    if (res != VK_SUCCESS) {
+        qWarning("PipelineCache: Failed to get pipeline cache data: %d", res);
+        return;
+    }
+    data.resize(size);
+
+    // Write to a temporary file first so a crash can't leave a truncated cache behind
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning("PipelineCache: Failed to write %s", qPrintable(path));
+        return;
+    }
+    qDebug() << "PipelineCache: Saved" << size << "bytes";
+}
@@ -0,0 +1,38 @@
+#ifndef PIPELINE_CACHE_HPP
+#define PIPELINE_CACHE_HPP
+
+#include <QVulkanInstance>
+#include <QString>
+
+#include "VulkanFunctions.hpp"
+
+// VkPipelineCache that is loaded from and saved to disk
+// The file is only used if its header matches the current vendor ID, device ID & pipelineCacheUUID (the driver might
+// not validate it itself), otherwise the cache starts out empty and the file is overwritten on `destroy`
+// Warning: `destroy` will not be called on destructor. It must explicitly be called after `create`
+class PipelineCache {
+public:
+    // An empty `path` disables loading & saving (the cache is still created)
+    VkResult create(VulkanData vkd, const QString& path);
+    // Saves the cache to disk before destroying it
+    void destroy();
+
+    VkPipelineCache get_vk_pipeline_cache() {return pipeline_cache;}
+
+    // True if valid data was loaded from disk
+    bool is_warm() {return loaded_bytes != 0;}
+    size_t get_loaded_bytes() {return loaded_bytes;}
+
+private:
+    VulkanData vkd{};
+    QString path;
+
+    // Returns false if `data` was not created by the current device & driver
+    bool is_compatible(const QByteArray& data);
+    void save();
+
+    VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+    size_t loaded_bytes = 0;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "StagingRing.hpp"
+
+#include <QDebug>
+
+#include <algorithm>
+
+VkResult StagingRing::create(VulkanData vkd, VkDeviceSize size) {
+    this->vkd = vkd;
+    return create_buffer(size);
+}
+
+void StagingRing::destroy() {
+    if (vkd.vkdf == nullptr)
+        return;
+
+    for (auto& retired_buffer : retired_buffers)
+        retired_buffer.buffer.destroy();
+    retired_buffers.clear();
+
+    buffer.destroy();
+    mapped = nullptr;
+    capacity = 0;
+
+    head = 0;
+    tail = 0;
+    used = 0;
+    batches.clear();
+    last_batch = 0;
+    pending_bytes = 0;
+
+    vkd = VulkanData{};
+}
+
+StagingRing::Region StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    VkDeviceSize offset = align_to(head, alignment);
+    VkDeviceSize skipped = offset - head;
+    bool found = false;
+
+    if (used == 0) {
+        head = tail = offset = skipped = 0;
+        found = size <= capacity;
+    }
+    else if (head > tail) {
+        // In use: [tail, head). Try the end of the buffer first, then wrap around to the start
+        if (offset + size <= capacity) {
+            found = true;
+        }
+        else if (size <= tail) {
+            skipped = capacity - head;
+            offset = 0;
+            found = true;
+        }
+    }
+    else if (head < tail) {
+        // In use: [tail, capacity) & [0, head)
+        found = offset + size <= tail;
+    }
+
+    if (!found) {
+        // Keep the old buffer alive until every batch that could be using it (including the current one) has retired
+        VkDeviceSize new_capacity = std::max(capacity, min_capacity) * 2;
+        while (new_capacity < size)
+            new_capacity *= 2;
+        qDebug() << "StagingRing: Growing from" << capacity << "to" << new_capacity << "bytes";
+
+        retired_buffers.push_back(RetiredBuffer{last_batch + 1, buffer});
+        buffer = Buffer{};
+        batches.clear();
+        pending_bytes = 0;
+
+        if (create_buffer(new_capacity) != VK_SUCCESS) {
+            qWarning("StagingRing: Failed to grow staging buffer");
+            return Region{};
+        }
+        offset = 0;
+        skipped = 0;
+    }
+
+    head = offset + size;
+    used += skipped + size;
+    pending_bytes += skipped + size;
+
+    return Region{buffer.get_vk_buffer(), offset, mapped + offset};
+}
+
+StagingRing::Region StagingRing::upload(const void* data, VkDeviceSize size, VkDeviceSize alignment) {
+    Region region = allocate(size, alignment);
+    if (region.data != nullptr)
+        memcpy(region.data, data, size);
+    return region;
+}
+
+uint64_t StagingRing::submit() {
+    last_batch++;
+    // Empty batches aren't tracked; retiring them is a no-op
+    if (pending_bytes != 0)
+        batches.push_back(Batch{last_batch, head, pending_bytes});
+    pending_bytes = 0;
+    return last_batch;
+}
+
+void StagingRing::retire(uint64_t batch) {
+    while (!batches.empty() && batches.front().id <= batch) {
+        tail = batches.front().end;
+        used -= batches.front().bytes;
+        batches.pop_front();
+    }
+
+    auto it = std::remove_if(retired_buffers.begin(), retired_buffers.end(), [batch](RetiredBuffer& retired_buffer) {
+        if (retired_buffer.last_batch > batch)
+            return false;
+        retired_buffer.buffer.destroy();
+        return true;
+    });
+    retired_buffers.erase(it, retired_buffers.end());
+}
+
+VkResult StagingRing::create_buffer(VkDeviceSize size) {
+    VkResult res = buffer.create(vkd, Buffer::CreateData{size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT});
+    if (res != VK_SUCCESS)
+        return res;
+
+    mapped = static_cast<uchar*>(buffer.get_mapped_memory());
+    capacity = size;
+    head = 0;
+    tail = 0;
+    used = 0;
+    return VK_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef STAGING_RING_HPP
+#define STAGING_RING_HPP
+
+#include <QVulkanInstance>
+
+#include <deque>
+#include <vector>
+
+#include "VulkanFunctions.hpp"
+#include "Buffer.hpp"
+
+// A persistently mapped, host-visible ring buffer used as the source of all uploads
+// Allocations are grouped into batches (usually one per frame). A batch is closed with `submit` and its memory is
+// given back with `retire` once the GPU has finished with it. Batches must be retired in the order they were submitted
+// If an allocation doesn't fit the ring grows; the old buffer is kept alive until every batch using it has retired
+// Warning: `destroy` will not be called on destructor. It must explicitly be called after `create`
+class StagingRing {
+public:
+    struct Region {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        void* data = nullptr; // nullptr if the allocation failed
+    };
+
+    static constexpr VkDeviceSize default_size = 8 * 1024 * 1024;
+    static constexpr VkDeviceSize min_capacity = 64 * 1024;
+
+    VkResult create(VulkanData vkd, VkDeviceSize size=default_size);
+    void destroy();
+
+    // The region stays valid until the batch it is part of is retired
+    Region allocate(VkDeviceSize size, VkDeviceSize alignment=16);
+    // Region with `data` already copied in
+    Region upload(const void* data, VkDeviceSize size, VkDeviceSize alignment=16);
+
+    // Close the current batch and return its id
+    uint64_t submit();
+    // Free the memory of every batch up to and including `batch`
+    void retire(uint64_t batch);
+
+    VkDeviceSize get_capacity() {return capacity;}
+    VkDeviceSize get_used_bytes() {return used;}
+
+private:
+    VulkanData vkd{};
+
+    VkResult create_buffer(VkDeviceSize size);
+    Buffer buffer{};
+    uchar* mapped = nullptr;
+    VkDeviceSize capacity = 0;
+
+    VkDeviceSize head = 0; // Next free byte
+    VkDeviceSize tail = 0; // Oldest byte still in use
+    VkDeviceSize used = 0; // Includes bytes skipped when wrapping around
+
+    struct Batch {
+        uint64_t id;
+        VkDeviceSize end;
+        VkDeviceSize bytes;
+    };
+    std::deque<Batch> batches;
+    uint64_t last_batch = 0;
+    VkDeviceSize pending_bytes = 0; // Bytes allocated since the last `submit`
+
+    struct RetiredBuffer {
+        uint64_t last_batch;
+        Buffer buffer;
+    };
+    std::vector<RetiredBuffer> retired_buffers;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "TextureStreamer.hpp"
+
+#include <QtConcurrent>
+#include <QDebug>
+
+VkResult TextureStreamer::create(VulkanData vkd, Uploader* uploader, MipGenerator* mip_generator, const VkPhysicalDeviceFeatures& enabled_features) {
+    this->vkd = vkd;
+    this->uploader = uploader;
+    this->mip_generator = mip_generator;
+    this->enabled_features = enabled_features;
+
+    create_placeholder();
+    return VK_SUCCESS;
+}
+
+void TextureStreamer::destroy() {
+    if (vkd.vkdf == nullptr)
+        return;
+
+    for (auto& texture : textures) {
+        if (texture.state == State::Decoding)
+            texture.future.waitForFinished();
+        texture.image.destroy();
+    }
+    textures.clear();
+    nr_pending = 0;
+
+    placeholder.destroy();
+
+    uploader = nullptr;
+    mip_generator = nullptr;
+    vkd = VulkanData{};
+}
+
+TextureStreamer::Handle TextureStreamer::request(const QStringList& paths) {
+    Texture texture{};
+    texture.future = QtConcurrent::run([vkd=vkd, enabled_features=enabled_features, paths]() {
+        return decode(vkd, enabled_features, paths);
+    });
+    textures.push_back(std::move(texture));
+    nr_pending++;
+
+    return textures.size() - 1;
+}
+
+void TextureStreamer::update() {
+    if (nr_pending == 0)
+        return;
+
+    VkDeviceSize uploaded_bytes = 0;
+    bool flush = false;
+    for (auto& texture : textures) {
+        if (texture.state == State::Uploading && uploader->is_ready(texture.upload_value)) {
+            texture.state = State::Resident;
+            nr_pending--;
+        }
+        else if (texture.state == State::Decoding && texture.future.isFinished() && uploaded_bytes < upload_budget) {
+            DecodedTexture decoded = texture.future.result();
+            VkDeviceSize size = upload(texture, decoded);
+            if (size == 0) {
+                qWarning("TextureStreamer: Failed to load texture %s", qPrintable(decoded.path));
+                texture.image.destroy();
+                texture.state = State::Failed;
+                nr_pending--;
+                continue;
+            }
+            uploaded_bytes += size;
+            texture.state = State::Uploading;
+            flush = true;
+        }
+    }
+
+    if (flush) {
+        uint64_t upload_value = uploader->flush();
+        for (auto& texture : textures) {
+            if (texture.state == State::Uploading && texture.upload_value == 0)
+                texture.upload_value = upload_value;
+        }
+    }
+}
+
+TextureStreamer::DecodedTexture TextureStreamer::decode(VulkanData vkd, VkPhysicalDeviceFeatures enabled_features, QStringList paths) {
+    DecodedTexture decoded{};
+    for (int i=0; i<paths.size(); i++) {
+        decoded.path = paths[i];
+        if (paths[i].endsWith(".ktx2")) {
+            Ktx2Texture::Header header;
+            if (!Ktx2Texture::read_header(paths[i], header) || !Ktx2Texture::is_format_supported(vkd, enabled_features, header.format))
+                continue;
+            if (decoded.ktx2_texture.load(paths[i])) {
+                decoded.is_ktx2 = true;
+                return decoded;
+            }
+        }
+        else {
+            decoded.image = QImage(paths[i]).convertToFormat(QImage::Format_RGBA8888);
+            if (!decoded.image.isNull())
+                return decoded;
+        }
+    }
+    return decoded;
+}
+
+VkDeviceSize TextureStreamer::upload(Texture& texture, DecodedTexture& decoded) {
+    Image::CreateData icd;
+    bool generate_ktx2_mip_levels = false;
+    if (decoded.is_ktx2) {
+        const Ktx2Texture::Header& header = decoded.ktx2_texture.get_header();
+        icd = Image::CreateData::default_texture_data(header.width, header.height);
+        icd.format = header.format;
+        icd.mip_levels = header.mip_levels;
+        icd.array_layers = header.array_layers;
+        // Block-compressed formats can't be generated, they keep their single level
+        generate_ktx2_mip_levels = header.generate_mip_levels && mip_generator->can_generate(icd.format);
+        if (generate_ktx2_mip_levels) {
+            icd.mip_levels = Image::get_max_mip_levels(icd.width, icd.height);
+            icd.usage |= mip_generator->get_required_usage(icd.format);
+        }
+    }
+    else {
+        if (decoded.image.isNull())
+            return 0;
+
+        icd = Image::CreateData::default_texture_data(decoded.image.width(), decoded.image.height());
+        if (mip_generator->can_generate(icd.format)) {
+            icd.mip_levels = Image::get_max_mip_levels(icd.width, icd.height);
+            icd.usage |= mip_generator->get_required_usage(icd.format);
+        }
+    }
+    icd.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    // Everything that can fail is done before any commands using the image are recorded
+    VkResult res = texture.image.create(vkd, icd);
+    if (res == VK_SUCCESS)
+        res = texture.image.create_view();
+    if (res == VK_SUCCESS)
+        res = create_sampler(texture.image);
+    if (res != VK_SUCCESS)
+        return 0;
+
+    if (generate_ktx2_mip_levels) {
+        // The only stored level holds every layer, like a decoded image
+        res = uploader->upload_to_image(
+            texture.image, decoded.ktx2_texture.get_level_data(), decoded.ktx2_texture.get_level_data_size(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+        );
+    }
+    else if (decoded.is_ktx2) {
+        res = uploader->upload_to_image(
+            texture.image, decoded.ktx2_texture.get_level_data(), decoded.ktx2_texture.get_level_data_size(), decoded.ktx2_texture.get_copy_regions(),
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+        );
+    }
+    else {
+        res = uploader->upload_to_image(
+            texture.image, decoded.image.constBits(), decoded.image.sizeInBytes(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+        );
+    }
+    if (res != VK_SUCCESS)
+        return 0;
+
+    return decoded.is_ktx2 ? decoded.ktx2_texture.get_level_data_size() : VkDeviceSize(decoded.image.sizeInBytes());
+}
+
+VkResult TextureStreamer::create_sampler(Image& image) {
+    VkSamplerCreateInfo sci = Image::default_texture_sampler_create_info(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, enabled_features.samplerAnisotropy);
+    sci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sci.maxLod = image.get_image_data().mip_levels;
+    return image.create_sampler(sci);
+}
+
+void TextureStreamer::create_placeholder() {
+    // 2x2 grey checkerboard, small enough to not need streaming itself
+    const uint32_t placeholder_data[4] = {0xFF808080, 0xFFC0C0C0, 0xFFC0C0C0, 0xFF808080};
+
+    Image::CreateData icd = Image::CreateData::default_texture_data(2, 2);
+    icd.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    VkResult res = placeholder.create(vkd, icd);
+    if (res != VK_SUCCESS)
+        qFatal("TextureStreamer: Failed to create placeholder texture: %d", res);
+
+    res = uploader->upload_to_image(
+        placeholder, placeholder_data, sizeof(placeholder_data), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+    );
+    if (res != VK_SUCCESS)
+        qFatal("TextureStreamer: Failed to upload placeholder texture: %d", res);
+    uploader->flush();
+
+    placeholder.create_view();
+    create_sampler(placeholder);
+}
\ No newline at end of file
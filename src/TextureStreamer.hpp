@@ -0,0 +1,90 @@
+#ifndef TEXTURE_STREAMER_HPP
+#define TEXTURE_STREAMER_HPP
+
+#include <QVulkanInstance>
+#include <QFuture>
+#include <QImage>
+#include <QStringList>
+
+#include <deque>
+
+#include "VulkanFunctions.hpp"
+#include "Image.hpp"
+#include "Uploader.hpp"
+#include "MipGenerator.hpp"
+#include "Ktx2Texture.hpp"
+
+// Loads textures in the background: files are read & decoded on QtConcurrent's thread pool, then uploaded through the
+// uploader without blocking. Until a texture is resident a small placeholder texture is handed out instead
+// `update` has to be called once per frame (by the render target, after the uploader's acquire barriers were recorded)
+// Only to be used from the thread that renders frames
+// Warning: `destroy` will not be called on destructor. It must explicitly be called after `create`
+class TextureStreamer {
+public:
+    using Handle = uint32_t;
+
+    VkResult create(VulkanData vkd, Uploader* uploader, MipGenerator* mip_generator, const VkPhysicalDeviceFeatures& enabled_features);
+    // Waits for the decoding that is still running
+    void destroy();
+
+    // `paths` are candidates in order of preference. The first KTX2 file the device supports or other image file
+    // (anything QImage reads, uploaded as RGBA8 with generated mip levels) that can be decoded is used
+    Handle request(const QStringList& paths);
+
+    // Starts the uploads of decoded textures (within the per frame budget) & marks finished uploads as resident
+    void update();
+
+    bool is_resident(Handle handle) {return textures[handle].state == State::Resident;}
+    bool has_failed(Handle handle) {return textures[handle].state == State::Failed;}
+    // The texture if it is resident, the placeholder otherwise
+    Image& get_image(Handle handle) {return is_resident(handle) ? textures[handle].image : placeholder;}
+    Image& get_placeholder() {return placeholder;}
+
+    uint32_t get_nr_pending() {return nr_pending;}
+
+    // Bytes of texture data uploaded per `update` (at least one texture is uploaded per update regardless)
+    void set_upload_budget(VkDeviceSize bytes) {upload_budget = bytes;}
+
+private:
+    VulkanData vkd{};
+    Uploader* uploader = nullptr;
+    MipGenerator* mip_generator = nullptr;
+    VkPhysicalDeviceFeatures enabled_features{};
+
+    enum class State {
+        Decoding,
+        Uploading,
+        Resident,
+        Failed,
+    };
+
+    // Produced by the worker threads
+    struct DecodedTexture {
+        QString path;
+        bool is_ktx2 = false;
+        Ktx2Texture ktx2_texture;
+        QImage image; // RGBA8888, only if not `is_ktx2`
+    };
+    static DecodedTexture decode(VulkanData vkd, VkPhysicalDeviceFeatures enabled_features, QStringList paths);
+
+    struct Texture {
+        State state = State::Decoding;
+        QFuture<DecodedTexture> future;
+        Image image{};
+        uint64_t upload_value = 0;
+    };
+    // A deque so the images don't move while the uploader still refers to them
+    std::deque<Texture> textures;
+    uint32_t nr_pending = 0;
+
+    // Returns the number of uploaded bytes (0 on failure)
+    VkDeviceSize upload(Texture& texture, DecodedTexture& decoded);
+    VkResult create_sampler(Image& image);
+
+    void create_placeholder();
+    Image placeholder{};
+
+    VkDeviceSize upload_budget = 16 * 1024 * 1024;
+};
+
+#endif
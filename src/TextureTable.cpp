@@ -0,0 +1,173 @@
+#include "TextureTable.hpp"
+
+#include <QVulkanFunctions>
+#include <QVulkanDeviceFunctions>
+#include <QStringList>
+#include <QDebug>
+
+#include <algorithm>
+
+void TextureTable::add_required_features(VkPhysicalDeviceVulkan12Features& features) {
+    features.descriptorIndexing = VK_TRUE;
+    features.runtimeDescriptorArray = VK_TRUE;
+    features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    features.descriptorBindingPartiallyBound = VK_TRUE;
+    features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+}
+
+QString TextureTable::get_missing_features(const VkPhysicalDeviceVulkan12Features& enabled_features) {
+    QStringList missing_features;
+    if (!enabled_features.runtimeDescriptorArray)
+        missing_features << "runtimeDescriptorArray";
+    if (!enabled_features.shaderSampledImageArrayNonUniformIndexing)
+        missing_features << "shaderSampledImageArrayNonUniformIndexing";
+    if (!enabled_features.descriptorBindingPartiallyBound)
+        missing_features << "descriptorBindingPartiallyBound";
+    if (!enabled_features.descriptorBindingSampledImageUpdateAfterBind)
+        missing_features << "descriptorBindingSampledImageUpdateAfterBind";
+    if (!enabled_features.descriptorBindingUpdateUnusedWhilePending)
+        missing_features << "descriptorBindingUpdateUnusedWhilePending";
+    return missing_features.join(", ");
+}
+
+VkResult TextureTable::create(VulkanData vkd, uint32_t max_textures, VkShaderStageFlags stages, bool single_texture) {
+    this->vkd = vkd;
+    this->single_texture = single_texture;
+    // Single texture: one set per texture
+    this->max_textures = std::min(max_textures, single_texture ? max_single_textures : get_max_supported_textures());
+    nr_textures = 0;
+
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = single_texture ? 1 : this->max_textures;
+    binding.stageFlags = stages;
+
+    VkDescriptorBindingFlags binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                             VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info{};
+    binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags_info.bindingCount = 1;
+    binding_flags_info.pBindingFlags = &binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    if (!single_texture) {
+        layout_info.pNext = &binding_flags_info;
+        layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    }
+    layout_info.bindingCount = 1;
+    layout_info.pBindings = &binding;
+
+    VkResult res = vkd.vkdf->vkCreateDescriptorSetLayout(vkd.device, &layout_info, nullptr, &descriptor_set_layout);
+    if (res != VK_SUCCESS) {
+        qWarning("TextureTable: Failed to create descriptor set layout: %d", res);
+        return res;
+    }
+
+    VkDescriptorPoolSize pool_size{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, this->max_textures};
+
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.flags = single_texture ? 0 : VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets = single_texture ? this->max_textures : 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+
+    res = vkd.vkdf->vkCreateDescriptorPool(vkd.device, &pool_info, nullptr, &descriptor_pool);
+    if (res != VK_SUCCESS) {
+        qWarning("TextureTable: Failed to create descriptor pool: %d", res);
+        return res;
+    }
+
+    // Single texture: the sets are allocated by `add`
+    if (single_texture)
+        return VK_SUCCESS;
+    return allocate_descriptor_set();
+}
+
+void TextureTable::destroy() {
+    // Also frees the set
+    vkd.vkdf->vkDestroyDescriptorPool(vkd.device, descriptor_pool, nullptr);
+    descriptor_pool = VK_NULL_HANDLE;
+    descriptor_set = VK_NULL_HANDLE;
+
+    vkd.vkdf->vkDestroyDescriptorSetLayout(vkd.device, descriptor_set_layout, nullptr);
+    descriptor_set_layout = VK_NULL_HANDLE;
+
+    max_textures = 0;
+    nr_textures = 0;
+    single_texture = false;
+}
+
+uint32_t TextureTable::add(VkImageView image_view, VkSampler sampler) {
+    if (nr_textures == max_textures) {
+        qWarning("TextureTable: Table is full (%u textures)", max_textures);
+        return invalid_slot;
+    }
+    if (single_texture && allocate_descriptor_set() != VK_SUCCESS)
+        return invalid_slot;
+    uint32_t slot = nr_textures++;
+
+    VkDescriptorImageInfo image_info{};
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    image_info.imageView = image_view;
+    image_info.sampler = sampler;
+
+    VkWriteDescriptorSet descriptor_write{};
+    descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptor_write.dstSet = descriptor_set;
+    descriptor_write.dstBinding = 0;
+    descriptor_write.dstArrayElement = single_texture ? 0 : slot;
+    descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptor_write.descriptorCount = 1;
+    descriptor_write.pImageInfo = &image_info;
+
+    vkd.vkdf->vkUpdateDescriptorSets(vkd.device, 1, &descriptor_write, 0, nullptr);
+    return slot;
+}
+
+VkResult TextureTable::allocate_descriptor_set() {
+    VkDescriptorSetAllocateInfo allocation_info{};
+    allocation_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocation_info.descriptorPool = descriptor_pool;
+    allocation_info.descriptorSetCount = 1;
+    allocation_info.pSetLayouts = &descriptor_set_layout;
+
+    // The current set is kept on failure, frames may still be using it
+    VkDescriptorSet new_descriptor_set = VK_NULL_HANDLE;
+    VkResult res = vkd.vkdf->vkAllocateDescriptorSets(vkd.device, &allocation_info, &new_descriptor_set);
+    if (res != VK_SUCCESS) {
+        qWarning("TextureTable: Failed to allocate descriptor set: %d", res);
+        return res;
+    }
+    descriptor_set = new_descriptor_set;
+    return VK_SUCCESS;
+}
+
+uint32_t TextureTable::get_max_supported_textures() {
+    VkPhysicalDeviceProperties properties;
+    vkd.vkf->vkGetPhysicalDeviceProperties(vkd.physical_device, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_2)
+        return 0;
+
+    auto vkGetPhysicalDeviceProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
+        vkd.instance->getInstanceProcAddr("vkGetPhysicalDeviceProperties2")
+    );
+
+    VkPhysicalDeviceVulkan12Properties vulkan12_properties{};
+    vulkan12_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &vulkan12_properties;
+    vkGetPhysicalDeviceProperties2(vkd.physical_device, &properties2);
+
+    // Combined image samplers count against both the sampler & sampled image limits
+    return std::min({
+        vulkan12_properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+        vulkan12_properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        vulkan12_properties.maxDescriptorSetUpdateAfterBindSamplers,
+        vulkan12_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+    });
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef TEXTURE_TABLE_HPP
+#define TEXTURE_TABLE_HPP
+
+#include <QVulkanInstance>
+#include <QString>
+
+#include "VulkanFunctions.hpp"
+
+// One descriptor set holding an array of combined image samplers that shaders index (descriptor indexing, core in
+// Vulkan 1.2), so any number of textures can be used without binding another set
+// The array is partially bound (unwritten slots are fine as long as they aren't used) & update-after-bind, so new
+// slots can be written while frames using the set are still in flight. Slots are never rewritten
+// Without descriptor indexing the table falls back to a single texture: the set layout holds one combined image sampler
+// & every `add` writes a new set (a set in use can't be updated), so shaders sample the last added texture
+// Warning: `destroy` will not be called on destructor. It must explicitly be called after `create`
+class TextureTable {
+public:
+    static constexpr uint32_t invalid_slot = UINT32_MAX;
+    static constexpr uint32_t max_single_textures = 16;
+
+    // Sets the Vulkan 1.2 features the table needs (to pass to `request_vulkan12_features`)
+    static void add_required_features(VkPhysicalDeviceVulkan12Features& features);
+    // The required features that aren't enabled, separated by commas (empty if they all are)
+    static QString get_missing_features(const VkPhysicalDeviceVulkan12Features& enabled_features);
+
+    // The array is the only binding (0) of its set layout. `max_textures` is clamped to the device's limits
+    // With `single_texture`, binding 0 is a single combined image sampler & at most `max_single_textures` can be added
+    VkResult create(VulkanData vkd, uint32_t max_textures, VkShaderStageFlags stages, bool single_texture=false);
+    void destroy();
+
+    // Writes the texture to the next slot & returns it (`invalid_slot` if the table is full)
+    uint32_t add(VkImageView image_view, VkSampler sampler);
+
+
+    // Getters
+
+    VkDescriptorSetLayout get_descriptor_set_layout() {return descriptor_set_layout;}
+    VkDescriptorSet get_descriptor_set() {return descriptor_set;}
+    uint32_t get_nr_textures() {return nr_textures;}
+    uint32_t get_max_textures() {return max_textures;}
+    bool is_single_texture() {return single_texture;}
+
+private:
+    VulkanData vkd{};
+
+    uint32_t get_max_supported_textures();
+    VkResult allocate_descriptor_set();
+
+    VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+
+    uint32_t max_textures = 0;
+    uint32_t nr_textures = 0;
+    bool single_texture = false;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "TransformHierarchy.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define TRANSFORM_HIERARCHY_SSE
+#include <immintrin.h>
+#endif
+
+namespace {
+    // `result` = `a` * `b`, all column-major & not aliasing
+    inline void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& result) {
+#ifdef TRANSFORM_HIERARCHY_SSE
+        const float* a_data = glm::value_ptr(a);
+        const float* b_data = glm::value_ptr(b);
+        float* result_data = glm::value_ptr(result);
+        __m128 a0 = _mm_loadu_ps(a_data);
+        __m128 a1 = _mm_loadu_ps(a_data + 4);
+        __m128 a2 = _mm_loadu_ps(a_data + 8);
+        __m128 a3 = _mm_loadu_ps(a_data + 12);
+        // Column j of the result is `a`'s columns weighted by column j of `b`
+        for (int j=0; j<4; j++) {
+            const float* b_column = b_data + 4*j;
+            __m128 column = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b_column[0])), _mm_mul_ps(a1, _mm_set1_ps(b_column[1]))),
+                _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b_column[2])), _mm_mul_ps(a3, _mm_set1_ps(b_column[3])))
+            );
+            _mm_storeu_ps(result_data + 4*j, column);
+        }
+#else
+        result = a * b;
+#endif
+    }
+}
+
+uint32_t TransformHierarchy::add_node(const glm::mat4& local, uint32_t parent) {
+    uint32_t node = this->parent.size();
+    this->local.push_back(local);
+    world.push_back(local);
+    this->parent.push_back(parent);
+    dirty.push_back(1);
+    first_dirty = std::min(first_dirty, node);
+    return node;
+}
+
+void TransformHierarchy::set_local(uint32_t node, const glm::mat4& local) {
+    this->local[node] = local;
+    dirty[node] = 1;
+    first_dirty = std::min(first_dirty, node);
+}
+
+void TransformHierarchy::clear() {
+    local.clear();
+    world.clear();
+    parent.clear();
+    dirty.clear();
+    first_dirty = 0;
+}
+
+uint32_t TransformHierarchy::update() {
+    uint32_t nr_nodes = parent.size();
+    if (first_dirty >= nr_nodes)
+        return 0;
+
+    // Dirtiness flows down in the same pass, the parent's world transform is always recomputed first
+    uint32_t nr_updated = 0;
+    for (uint32_t node=first_dirty; node<nr_nodes; node++) {
+        uint32_t node_parent = parent[node];
+        if (node_parent != no_parent)
+            dirty[node] |= dirty[node_parent];
+        if (!dirty[node])
+            continue;
+
+        if (node_parent == no_parent)
+            world[node] = local[node];
+        else
+            multiply(world[node_parent], local[node], world[node]);
+        nr_updated++;
+    }
+
+    std::fill(dirty.begin() + first_dirty, dirty.end(), 0);
+    first_dirty = nr_nodes;
+    return nr_updated;
+}
\ No newline at end of file
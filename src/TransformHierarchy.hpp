@@ -0,0 +1,44 @@
+#ifndef TRANSFORM_HIERARCHY_HPP
+#define TRANSFORM_HIERARCHY_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// Local & world transforms of a tree of nodes, stored as parallel arrays in parent-before-child order
+// Changing a local transform marks the node dirty. `update` recomputes the world transforms of the dirty nodes &
+// their descendants in one pass over the arrays (4x4 multiplies with SSE where available)
+class TransformHierarchy {
+public:
+    static constexpr uint32_t no_parent = UINT32_MAX;
+
+    // `parent` must be an existing node (or `no_parent`), so parents always come before their children
+    // Returns the index of the new node
+    uint32_t add_node(const glm::mat4& local, uint32_t parent = no_parent);
+    void set_local(uint32_t node, const glm::mat4& local);
+    void clear();
+
+    // Returns the number of world transforms recomputed
+    uint32_t update();
+
+
+    // Getters
+
+    uint32_t get_nr_nodes() const {return parent.size();}
+    uint32_t get_parent(uint32_t node) const {return parent[node];}
+    const glm::mat4& get_local(uint32_t node) const {return local[node];}
+    // Only up to date after `update`
+    const glm::mat4& get_world(uint32_t node) const {return world[node];}
+    bool is_dirty() const {return first_dirty < parent.size();}
+
+private:
+    std::vector<glm::mat4> local;
+    std::vector<glm::mat4> world;
+    std::vector<uint32_t> parent;
+    std::vector<uint8_t> dirty;
+    // Nodes before it are all clean (and so are their subtrees, since children come after their parents)
+    uint32_t first_dirty = 0;
+};
+
+#endif
\ No newline at end of file
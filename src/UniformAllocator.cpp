@@ -0,0 +1,73 @@
+#include "UniformAllocator.hpp"
+
+#include <QDebug>
+
+#include <cstring>
+
+VkResult UniformAllocator::create(VulkanData vkd, uint32_t nr_frames, VkDeviceSize frame_size) {
+    this->vkd = vkd;
+
+    VkPhysicalDeviceProperties pdp;
+    vkd.vkf->vkGetPhysicalDeviceProperties(vkd.physical_device, &pdp);
+    alignment = pdp.limits.minUniformBufferOffsetAlignment;
+
+    // Every region starts aligned, so dynamic offsets stay aligned
+    this->frame_size = align_to(frame_size, alignment);
+    this->nr_frames = nr_frames;
+
+    // Written once & read by the device, so device-local host-visible (resizable BAR) memory is best
+    Buffer::CreateData bcd{this->frame_size * nr_frames, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT};
+    bcd.preferred_memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkResult res = buffer.create(vkd, bcd);
+    if (res != VK_SUCCESS) {
+        qWarning("UniformAllocator: Failed to create uniform buffer: %d", res);
+        return res;
+    }
+    mapped = static_cast<uchar*>(buffer.get_mapped_memory());
+
+    begin_frame(0);
+    return VK_SUCCESS;
+}
+
+void UniformAllocator::destroy() {
+    if (vkd.vkdf == nullptr)
+        return;
+
+    buffer.destroy();
+    mapped = nullptr;
+    alignment = 0;
+    frame_size = 0;
+    nr_frames = 0;
+    frame_begin = 0;
+    head = 0;
+
+    vkd = VulkanData{};
+}
+
+void UniformAllocator::begin_frame(uint32_t frame_index) {
+    frame_begin = frame_index * frame_size;
+    head = frame_begin;
+}
+
+UniformAllocator::Chunk UniformAllocator::allocate(VkDeviceSize size) {
+    VkDeviceSize offset = align_to(head, alignment);
+    if (offset + size > frame_begin + frame_size) {
+        qWarning("UniformAllocator: Frame region of %llu bytes is full", (unsigned long long)frame_size);
+        return Chunk{};
+    }
+    head = offset + size;
+    return Chunk{uint32_t(offset), mapped + offset};
+}
+
+VkResult UniformAllocator::flush() {
+    if (head == frame_begin)
+        return VK_SUCCESS;
+    return buffer.flush(frame_begin, head - frame_begin);
+}
+
+UniformAllocator::Chunk UniformAllocator::upload(const void* data, VkDeviceSize size) {
+    Chunk chunk = allocate(size);
+    if (chunk.data != nullptr)
+        memcpy(chunk.data, data, size);
+    return chunk;
+}
\ No newline at end of file
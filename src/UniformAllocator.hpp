@@ -0,0 +1,62 @@
+#ifndef UNIFORM_ALLOCATOR_HPP
+#define UNIFORM_ALLOCATOR_HPP
+
+#include <QVulkanInstance>
+
+#include "VulkanFunctions.hpp"
+#include "Buffer.hpp"
+
+// Hands out chunks of a persistently mapped uniform buffer for data that only lives for one frame
+// The buffer has a fixed region per frame in flight. Chunks are allocated linearly from the current frame's region &
+// aligned to `minUniformBufferOffsetAlignment`, so their offset can be used as the dynamic offset of a
+// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor pointing at `get_vk_buffer()`. One such descriptor set can be
+// bound for any number of draws without creating new buffers or sets
+// `begin_frame` starts over at the beginning of a frame's region, once the frame's fence has signaled
+// Warning: `destroy` will not be called on destructor. It must explicitly be called after `create`
+class UniformAllocator {
+public:
+    struct Chunk {
+        uint32_t offset = 0; // Dynamic offset
+        void* data = nullptr; // nullptr if the frame's region is full
+    };
+
+    static constexpr VkDeviceSize default_frame_size = 256 * 1024;
+
+    VkResult create(VulkanData vkd, uint32_t nr_frames, VkDeviceSize frame_size=default_frame_size);
+    void destroy();
+
+    // Chunks of the previous use of `frame_index`'s region may no longer be in use
+    void begin_frame(uint32_t frame_index);
+
+    // Valid until the frame it was allocated in is begun again
+    Chunk allocate(VkDeviceSize size);
+    // Chunk with `data` already copied in
+    Chunk upload(const void* data, VkDeviceSize size);
+    template<typename T>
+    Chunk upload(const T& data) {return upload(&data, sizeof(T));}
+    // Makes the current frame's chunks visible to the device if the memory isn't coherent. Call before submitting the frame
+    VkResult flush();
+
+
+    // Getters
+
+    VkBuffer get_vk_buffer() {return buffer.get_vk_buffer();}
+    VkDeviceSize get_alignment() {return alignment;}
+    VkDeviceSize get_frame_size() {return frame_size;}
+    // Bytes allocated in the current frame (including alignment padding)
+    VkDeviceSize get_used_bytes() {return head - frame_begin;}
+
+private:
+    VulkanData vkd{};
+
+    Buffer buffer{};
+    uchar* mapped = nullptr;
+    VkDeviceSize alignment = 0;
+    VkDeviceSize frame_size = 0;
+    uint32_t nr_frames = 0;
+
+    VkDeviceSize frame_begin = 0;
+    VkDeviceSize head = 0; // Next free byte of the current frame's region
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,381 @@
+#include "Uploader.hpp"
+
+#include <QDebug>
+
+VkResult Uploader::create(VulkanData vkd, const CreateData& ucd) {
+    this->vkd = vkd;
+    this->ucd = ucd;
+
+    // Without timeline semaphores there is no cheap way to know when the transfer queue is done, so stay on the graphics queue
+    if (!ucd.timeline_semaphores) {
+        this->ucd.transfer_family = ucd.graphics_family;
+        this->ucd.transfer_queue = ucd.graphics_queue;
+    }
+
+    VkResult res;
+
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.queueFamilyIndex = this->ucd.transfer_family;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    res = vkd.vkdf->vkCreateCommandPool(vkd.device, &pool_info, nullptr, &command_pool);
+    if (res != VK_SUCCESS)
+        return res;
+
+    if (ucd.timeline_semaphores) {
+        vkGetSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValue>(
+            vkd.vkf->vkGetDeviceProcAddr(vkd.device, "vkGetSemaphoreCounterValue")
+        );
+        vkWaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphores>(
+            vkd.vkf->vkGetDeviceProcAddr(vkd.device, "vkWaitSemaphores")
+        );
+
+        VkSemaphoreTypeCreateInfo semaphore_type_info{};
+        semaphore_type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        semaphore_type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        semaphore_type_info.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphore_info{};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_info.pNext = &semaphore_type_info;
+
+        res = vkd.vkdf->vkCreateSemaphore(vkd.device, &semaphore_info, nullptr, &timeline_semaphore);
+        if (res != VK_SUCCESS)
+            return res;
+    }
+
+    qDebug() << "Uploader: Using" << (has_dedicated_transfer_queue() ? "dedicated transfer queue" : "graphics queue")
+             << (ucd.timeline_semaphores ? "with timeline semaphores" : "(blocking)");
+
+    return staging_ring.create(vkd);
+}
+
+void Uploader::destroy() {
+    if (vkd.vkdf == nullptr)
+        return;
+
+    if (recording_batch.command_buffer != VK_NULL_HANDLE)
+        flush();
+    wait(last_value);
+
+    for (auto& batch : submitted_batches)
+        vkd.vkdf->vkFreeCommandBuffers(vkd.device, command_pool, 1, &batch.command_buffer);
+    submitted_batches.clear();
+
+    staging_ring.destroy();
+
+    vkd.vkdf->vkDestroySemaphore(vkd.device, timeline_semaphore, nullptr);
+    timeline_semaphore = VK_NULL_HANDLE;
+    vkd.vkdf->vkDestroyCommandPool(vkd.device, command_pool, nullptr);
+    command_pool = VK_NULL_HANDLE;
+
+    vkGetSemaphoreCounterValue = nullptr;
+    vkWaitSemaphores = nullptr;
+    last_value = 0;
+    acquired_value = 0;
+
+    vkd = VulkanData{};
+    ucd = CreateData{};
+}
+
+VkResult Uploader::upload_to_buffer(VkBuffer buffer, const void* data, VkDeviceSize size, VkDeviceSize dst_offset, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    StagingRing::Region region = staging_ring.upload(data, size);
+    if (region.data == nullptr)
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+    VkCommandBuffer command_buffer = get_recording_command_buffer();
+
+    VkBufferCopy copy_region{region.offset, dst_offset, size};
+    vkd.vkdf->vkCmdCopyBuffer(command_buffer, region.buffer, buffer, 1, &copy_region);
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.buffer = buffer;
+    barrier.offset = dst_offset;
+    barrier.size = size;
+
+    if (has_dedicated_transfer_queue()) {
+        // Release half of the ownership transfer
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = ucd.transfer_family;
+        barrier.dstQueueFamilyIndex = ucd.graphics_family;
+        vkd.vkdf->vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            1, &barrier,
+            0, nullptr
+        );
+
+        // Acquire half (recorded on the graphics queue by `record_acquire_barriers`)
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dst_access;
+        recording_batch.buffer_acquire_barriers.push_back(barrier);
+        recording_batch.dst_stages |= dst_stage;
+    }
+    else {
+        barrier.dstAccessMask = dst_access;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        vkd.vkdf->vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage,
+            0,
+            0, nullptr,
+            1, &barrier,
+            0, nullptr
+        );
+    }
+
+    return VK_SUCCESS;
+}
+
+VkResult Uploader::upload_to_image(Image& image, const void* data, VkDeviceSize size, VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    const Image::CreateData& image_data = image.get_image_data();
+
+    bool generate_mip_levels = false;
+    if (image_data.mip_levels > 1) {
+        generate_mip_levels = ucd.mip_generator != nullptr && ucd.mip_generator->can_generate(image_data.format);
+        if (!generate_mip_levels)
+            qWarning("Uploader: Can't generate mip levels for format %d, only the first level is uploaded", image_data.format);
+    }
+
+    VkBufferImageCopy copy_region{};
+    copy_region.bufferOffset = 0;
+    copy_region.imageSubresource.aspectMask = image_data.aspect_flags;
+    copy_region.imageSubresource.mipLevel = 0;
+    copy_region.imageSubresource.baseArrayLayer = 0;
+    copy_region.imageSubresource.layerCount = image_data.array_layers;
+    copy_region.imageExtent = {image_data.width, image_data.height, 1};
+
+    return record_image_upload(image, data, size, &copy_region, 1, generate_mip_levels, final_layout, dst_stage, dst_access);
+}
+
+VkResult Uploader::upload_to_image(Image& image, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& copy_regions, VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    return record_image_upload(image, data, size, copy_regions.data(), copy_regions.size(), false, final_layout, dst_stage, dst_access);
+}
+
+VkResult Uploader::record_image_upload(Image& image, const void* data, VkDeviceSize size, const VkBufferImageCopy* copy_regions, uint32_t nr_copy_regions,
+                                       bool generate_mip_levels, VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    StagingRing::Region region = staging_ring.upload(data, size);
+    if (region.data == nullptr)
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+    VkCommandBuffer command_buffer = get_recording_command_buffer();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image.get_vk_image();
+    barrier.subresourceRange = image.get_subresource_range();
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    vkd.vkdf->vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier
+    );
+
+    // Every level & layer in one copy
+    std::vector<VkBufferImageCopy> staging_copy_regions(copy_regions, copy_regions + nr_copy_regions);
+    for (auto& copy_region : staging_copy_regions)
+        copy_region.bufferOffset += region.offset;
+    vkd.vkdf->vkCmdCopyBufferToImage(command_buffer, region.buffer, image.get_vk_image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, staging_copy_regions.size(), staging_copy_regions.data());
+
+    if (generate_mip_levels) {
+        if (has_dedicated_transfer_queue()) {
+            // Transfer the ownership without changing the layout & generate the mip levels on the graphics queue once acquired
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = ucd.transfer_family;
+            barrier.dstQueueFamilyIndex = ucd.graphics_family;
+            vkd.vkdf->vkCmdPipelineBarrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                0,
+                0, nullptr,
+                0, nullptr,
+                1, &barrier
+            );
+
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            recording_batch.image_acquire_barriers.push_back(barrier);
+            recording_batch.dst_stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+            recording_batch.mip_generations.push_back({&image, final_layout, dst_stage, dst_access});
+        }
+        else {
+            ucd.mip_generator->generate(command_buffer, image, final_layout, dst_stage, dst_access);
+        }
+        return VK_SUCCESS;
+    }
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = final_layout;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    if (has_dedicated_transfer_queue()) {
+        // Release half of the ownership transfer (the layout transition is part of both halves)
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = ucd.transfer_family;
+        barrier.dstQueueFamilyIndex = ucd.graphics_family;
+        vkd.vkdf->vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier
+        );
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dst_access;
+        recording_batch.image_acquire_barriers.push_back(barrier);
+        recording_batch.dst_stages |= dst_stage;
+    }
+    else {
+        barrier.dstAccessMask = dst_access;
+        vkd.vkdf->vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier
+        );
+    }
+
+    return VK_SUCCESS;
+}
+
+uint64_t Uploader::flush() {
+    if (recording_batch.command_buffer == VK_NULL_HANDLE)
+        return 0;
+
+    recording_batch.staging_batch = staging_ring.submit();
+    recording_batch.value = ++last_value;
+
+    if (ucd.timeline_semaphores) {
+        VkResult res = vkd.vkdf->vkEndCommandBuffer(recording_batch.command_buffer);
+        if (res != VK_SUCCESS)
+            qFatal("Uploader: Failed to end recording upload commands: %d", res);
+
+        VkSubmitInfo submit_info{};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &recording_batch.command_buffer;
+
+        VkTimelineSemaphoreSubmitInfo timeline_info{};
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &recording_batch.value;
+
+        submit_info.pNext = &timeline_info;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &timeline_semaphore;
+
+        res = vkd.vkdf->vkQueueSubmit(ucd.transfer_queue, 1, &submit_info, VK_NULL_HANDLE);
+        if (res != VK_SUCCESS)
+            qFatal("Uploader: Failed to submit upload commands: %d", res);
+
+        submitted_batches.push_back(std::move(recording_batch));
+    }
+    else {
+        end_single_time_commands(vkd, command_pool, ucd.transfer_queue, recording_batch.command_buffer);
+        staging_ring.retire(recording_batch.staging_batch);
+        acquired_value = recording_batch.value;
+    }
+
+    recording_batch = Batch{};
+    return last_value;
+}
+
+void Uploader::wait(uint64_t value, uint64_t timeout) {
+    if (!ucd.timeline_semaphores || value == 0)
+        return;
+
+    VkSemaphoreWaitInfo wait_info{};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &timeline_semaphore;
+    wait_info.pValues = &value;
+
+    VkResult res = vkWaitSemaphores(vkd.device, &wait_info, timeout);
+    if (res != VK_SUCCESS)
+        qWarning("Uploader: Timeout waiting for uploads: %d", res);
+}
+
+uint64_t Uploader::record_acquire_barriers(VkCommandBuffer command_buffer) {
+    if (submitted_batches.empty())
+        return 0;
+
+    uint64_t completed_value = get_completed_value();
+    uint64_t wait_value = 0;
+
+    VkPipelineStageFlags dst_stages = 0;
+    std::vector<VkBufferMemoryBarrier> buffer_barriers;
+    std::vector<VkImageMemoryBarrier> image_barriers;
+    std::vector<Batch::MipGeneration> mip_generations;
+
+    while (!submitted_batches.empty() && submitted_batches.front().value <= completed_value) {
+        Batch& batch = submitted_batches.front();
+
+        if (!batch.buffer_acquire_barriers.empty() || !batch.image_acquire_barriers.empty()) {
+            buffer_barriers.insert(buffer_barriers.end(), batch.buffer_acquire_barriers.begin(), batch.buffer_acquire_barriers.end());
+            image_barriers.insert(image_barriers.end(), batch.image_acquire_barriers.begin(), batch.image_acquire_barriers.end());
+            mip_generations.insert(mip_generations.end(), batch.mip_generations.begin(), batch.mip_generations.end());
+            dst_stages |= batch.dst_stages;
+            wait_value = batch.value;
+        }
+
+        vkd.vkdf->vkFreeCommandBuffers(vkd.device, command_pool, 1, &batch.command_buffer);
+        staging_ring.retire(batch.staging_batch);
+        acquired_value = batch.value;
+
+        submitted_batches.pop_front();
+    }
+
+    if (!buffer_barriers.empty() || !image_barriers.empty()) {
+        vkd.vkdf->vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stages,
+            0,
+            0, nullptr,
+            buffer_barriers.size(), buffer_barriers.data(),
+            image_barriers.size(), image_barriers.data()
+        );
+    }
+
+    for (auto& mip_generation : mip_generations)
+        ucd.mip_generator->generate(command_buffer, *mip_generation.image, mip_generation.final_layout, mip_generation.dst_stage, mip_generation.dst_access);
+
+    return wait_value;
+}
+
+VkCommandBuffer Uploader::get_recording_command_buffer() {
+    if (recording_batch.command_buffer == VK_NULL_HANDLE)
+        recording_batch.command_buffer = begin_single_time_commands(vkd, command_pool);
+    return recording_batch.command_buffer;
+}
+
+uint64_t Uploader::get_completed_value() {
+    if (!ucd.timeline_semaphores)
+        return last_value;
+
+    uint64_t value = 0;
+    VkResult res = vkGetSemaphoreCounterValue(vkd.device, timeline_semaphore, &value);
+    if (res != VK_SUCCESS)
+        qWarning("Uploader: Failed to get timeline semaphore value: %d", res);
+    return value;
+}
\ No newline at end of file
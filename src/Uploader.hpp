@@ -0,0 +1,102 @@
+#ifndef UPLOADER_HPP
+#define UPLOADER_HPP
+
+#include <QVulkanInstance>
+
+#include <deque>
+#include <vector>
+
+#include "VulkanFunctions.hpp"
+#include "StagingRing.hpp"
+#include "Image.hpp"
+#include "MipGenerator.hpp"
+
+// Uploads data into buffers & images without blocking the frame loop
+// Uses a dedicated transfer queue (with queue family ownership transfers) if the device has one and the graphics queue otherwise
+// Completion is tracked with a timeline semaphore. Without timeline semaphore support every `flush` blocks until the upload is done
+// Usage: record uploads, `flush` them and use the resources once `is_ready` returns true for the value returned by `flush`
+// Only to be used from the thread that renders frames
+// Warning: `destroy` will not be called on destructor. It must explicitly be called after `create`
+class Uploader {
+public:
+    class CreateData {
+    public:
+        uint32_t graphics_family;
+        VkQueue graphics_queue;
+        uint32_t transfer_family; // Same as `graphics_family` if there is no dedicated transfer queue
+        VkQueue transfer_queue;
+        bool timeline_semaphores;
+        MipGenerator* mip_generator; // Fills the mip chains of uploaded images (on the graphics queue)
+    };
+
+    VkResult create(VulkanData vkd, const CreateData& ucd);
+    void destroy();
+
+    // `dst_stage` & `dst_access` describe the first use of the buffer on the graphics queue
+    VkResult upload_to_buffer(VkBuffer buffer, const void* data, VkDeviceSize size, VkDeviceSize dst_offset, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+    // The whole image is overwritten and transitioned to `final_layout`
+    // `data` holds the first mip level of every layer. The other mip levels are generated from it
+    // With a dedicated transfer queue the generation is recorded by `record_acquire_barriers`, so `image` must stay alive until then
+    VkResult upload_to_image(Image& image, const void* data, VkDeviceSize size, VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+    // Uploads pre-baked data (e.g. the mip levels of a compressed texture) with one copy per region
+    // The buffer offsets of `copy_regions` are relative to `data` & must respect the format's alignment. Nothing is generated
+    VkResult upload_to_image(Image& image, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& copy_regions, VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+
+    // Submit everything recorded since the last flush
+    // Returns the value the uploads will be identified with (0 if nothing was recorded)
+    uint64_t flush();
+
+    // True once the uploads are done and are usable by commands recorded on the graphics queue
+    bool is_ready(uint64_t value) {return value <= acquired_value;}
+    // Block until the uploads are done on the transfer queue
+    void wait(uint64_t value, uint64_t timeout=1'000'000'000);
+
+    // Records the graphics-side half of the ownership transfers of every finished upload into `command_buffer`
+    // (followed by the mip generation of the uploaded images)
+    // Has to be called outside a render pass before any of the uploaded resources are used in the command buffer
+    // Returns the timeline value the command buffer's submission has to wait on (0 if no wait is needed)
+    uint64_t record_acquire_barriers(VkCommandBuffer command_buffer);
+
+    VkSemaphore get_timeline_semaphore() {return timeline_semaphore;}
+    bool has_dedicated_transfer_queue() {return ucd.transfer_family != ucd.graphics_family;}
+
+private:
+    VulkanData vkd{};
+    CreateData ucd{};
+
+    PFN_vkGetSemaphoreCounterValue vkGetSemaphoreCounterValue = nullptr;
+    PFN_vkWaitSemaphores vkWaitSemaphores = nullptr;
+
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    VkSemaphore timeline_semaphore = VK_NULL_HANDLE;
+    StagingRing staging_ring{};
+
+    struct Batch {
+        uint64_t value = 0;
+        uint64_t staging_batch = 0;
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        VkPipelineStageFlags dst_stages = 0;
+        std::vector<VkBufferMemoryBarrier> buffer_acquire_barriers;
+        std::vector<VkImageMemoryBarrier> image_acquire_barriers;
+
+        struct MipGeneration {
+            Image* image;
+            VkImageLayout final_layout;
+            VkPipelineStageFlags dst_stage;
+            VkAccessFlags dst_access;
+        };
+        std::vector<MipGeneration> mip_generations;
+    };
+    Batch recording_batch{};
+    std::deque<Batch> submitted_batches;
+
+    VkCommandBuffer get_recording_command_buffer();
+    VkResult record_image_upload(Image& image, const void* data, VkDeviceSize size, const VkBufferImageCopy* copy_regions, uint32_t nr_copy_regions,
+                                 bool generate_mip_levels, VkImageLayout final_layout, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+    uint64_t get_completed_value();
+
+    uint64_t last_value = 0;
+    uint64_t acquired_value = 0;
+};
+
+#endif
\ No newline at end of file
@@ -1,18 +1,53 @@
 #ifndef VERTEX_HPP
 #define VERTEX_HPP
 
-#include <array>
+#include <cstddef>
 #include <QVulkanFunctions>
 #include <glm/glm.hpp>
 
+#include "VertexLayout.hpp"
+
 struct Vertex {
     glm::vec3 position;
     glm::vec3 color;
     glm::vec2 tex_coord;
+};
 
-    static VkVertexInputBindingDescription get_binding_description();
-    static std::array<VkVertexInputAttributeDescription, 3> get_attribute_descriptions();
+template<> struct VertexLayout<Vertex> : VertexAttributeList<Vertex,
+    VertexAttribute<0, glm::vec3, offsetof(Vertex, position)>,
+    VertexAttribute<1, glm::vec3, offsetof(Vertex, color)>,
+    VertexAttribute<2, glm::vec2, offsetof(Vertex, tex_coord)>
+> {};
+
+// Quantized `Vertex` at half the size, made by VertexQuantizer
+struct PackedVertex {
+    // Normalized to the mesh's bounding box, w is unused
+    Snorm16x4 position;
+    Unorm8x4 color;
+    Half2 tex_coord;
 };
+static_assert(sizeof(PackedVertex) == 16, "Unexpected PackedVertex size");
+
+template<> struct VertexLayout<PackedVertex> : VertexAttributeList<PackedVertex,
+    VertexAttribute<0, Snorm16x4, offsetof(PackedVertex, position)>,
+    VertexAttribute<1, Unorm8x4, offsetof(PackedVertex, color)>,
+    VertexAttribute<2, Half2, offsetof(PackedVertex, tex_coord)>
+> {};
+
+// Per-instance data, read with VK_VERTEX_INPUT_RATE_INSTANCE from binding 1
+struct InstanceData {
+    glm::mat4 model;
+    uint32_t material_index;
+};
+
+// A matrix attribute takes one location per column
+template<> struct VertexLayout<InstanceData> : VertexAttributeList<InstanceData,
+    VertexAttribute<3, glm::vec4, offsetof(InstanceData, model)>,
+    VertexAttribute<4, glm::vec4, offsetof(InstanceData, model) + sizeof(glm::vec4)>,
+    VertexAttribute<5, glm::vec4, offsetof(InstanceData, model) + 2*sizeof(glm::vec4)>,
+    VertexAttribute<6, glm::vec4, offsetof(InstanceData, model) + 3*sizeof(glm::vec4)>,
+    VertexAttribute<7, uint32_t, offsetof(InstanceData, material_index)>
+> {};
 
 typedef uint32_t Index;
 
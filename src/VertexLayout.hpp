@@ -0,0 +1,69 @@
+#ifndef VERTEX_LAYOUT_HPP
+#define VERTEX_LAYOUT_HPP
+
+#include <array>
+#include <cstdint>
+#include <QVulkanFunctions>
+#include <glm/glm.hpp>
+
+// Storage types of packed attributes. The vertex input stage converts them back to floats,
+// so the shaders read them as `vec2`/`vec3`/`vec4` like unpacked attributes (see VertexQuantizer for the encoding)
+struct Half2 { uint16_t x, y; };
+struct Half4 { uint16_t x, y, z, w; };
+struct Snorm16x4 { int16_t x, y, z, w; };
+struct Unorm8x4 { uint8_t x, y, z, w; };
+// Unit vector mapped onto an octahedron & unfolded to [-1,1]^2, decoded in the shader
+struct OctahedralNormal { int16_t x, y; };
+
+// Format the vertex input stage reads an attribute of type `T` with
+template<typename T>
+struct VertexFormat;
+
+template<> struct VertexFormat<float> { static constexpr VkFormat format = VK_FORMAT_R32_SFLOAT; };
+template<> struct VertexFormat<uint32_t> { static constexpr VkFormat format = VK_FORMAT_R32_UINT; };
+template<> struct VertexFormat<glm::vec2> { static constexpr VkFormat format = VK_FORMAT_R32G32_SFLOAT; };
+template<> struct VertexFormat<glm::vec3> { static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT; };
+template<> struct VertexFormat<glm::vec4> { static constexpr VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT; };
+template<> struct VertexFormat<Half2> { static constexpr VkFormat format = VK_FORMAT_R16G16_SFLOAT; };
+template<> struct VertexFormat<Half4> { static constexpr VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT; };
+template<> struct VertexFormat<Snorm16x4> { static constexpr VkFormat format = VK_FORMAT_R16G16B16A16_SNORM; };
+template<> struct VertexFormat<Unorm8x4> { static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM; };
+template<> struct VertexFormat<OctahedralNormal> { static constexpr VkFormat format = VK_FORMAT_R16G16_SNORM; };
+
+// Attribute of type `T` at byte `Offset` of the vertex, read by the shader input at `Location`
+template<uint32_t Location, typename T, uint32_t Offset>
+struct VertexAttribute {
+    static constexpr uint32_t location = Location;
+    static constexpr uint32_t offset = Offset;
+    static constexpr uint32_t size = sizeof(T);
+
+    static constexpr VkVertexInputAttributeDescription get_description(uint32_t binding) {
+        return VkVertexInputAttributeDescription{Location, binding, VertexFormat<T>::format, Offset};
+    }
+};
+
+// Binding & attribute descriptions of vertex type `V` made from its list of attributes
+template<typename V, typename... Attributes>
+struct VertexAttributeList {
+    static_assert(((Attributes::offset + Attributes::size <= sizeof(V)) && ...), "Vertex attribute outside of the vertex");
+
+    static constexpr uint32_t attribute_count = sizeof...(Attributes);
+
+    static constexpr VkVertexInputBindingDescription get_binding_description(uint32_t binding=0, VkVertexInputRate input_rate=VK_VERTEX_INPUT_RATE_VERTEX) {
+        return VkVertexInputBindingDescription{binding, sizeof(V), input_rate};
+    }
+
+    static constexpr std::array<VkVertexInputAttributeDescription, sizeof...(Attributes)> get_attribute_descriptions(uint32_t binding=0) {
+        return {{Attributes::get_description(binding)...}};
+    }
+};
+
+// Specialized for every vertex type (deriving from VertexAttributeList) right after its definition:
+// template<> struct VertexLayout<MyVertex> : VertexAttributeList<MyVertex,
+//     VertexAttribute<0, glm::vec3, offsetof(MyVertex, position)>,
+//     ...
+// > {};
+template<typename V>
+struct VertexLayout;
+
+#endif
\ No newline at end of file
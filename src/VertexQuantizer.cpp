@@ -0,0 +1,108 @@
+#include "VertexQuantizer.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+uint16_t VertexQuantizer::to_half(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t float_exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    int32_t exponent = int32_t(float_exponent) - 127 + 15;
+
+    // Infinity & NaN
+    if (float_exponent == 0xFF)
+        return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+    if (exponent >= 31)
+        return sign | 0x7C00;
+
+    // Denormal half (or zero if even that is too small)
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half_mantissa & 1)))
+            half_mantissa++;
+        return sign | half_mantissa;
+    }
+
+    // A carry out of the mantissa correctly increments the exponent
+    uint32_t half = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++;
+    return half;
+}
+
+int16_t VertexQuantizer::to_snorm16(float value) {
+    return int16_t(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+uint8_t VertexQuantizer::to_unorm8(float value) {
+    return uint8_t(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+Half2 VertexQuantizer::encode_half2(glm::vec2 value) {
+    return Half2{to_half(value.x), to_half(value.y)};
+}
+
+Half4 VertexQuantizer::encode_half4(glm::vec4 value) {
+    return Half4{to_half(value.x), to_half(value.y), to_half(value.z), to_half(value.w)};
+}
+
+Snorm16x4 VertexQuantizer::encode_snorm16x4(glm::vec4 value) {
+    return Snorm16x4{to_snorm16(value.x), to_snorm16(value.y), to_snorm16(value.z), to_snorm16(value.w)};
+}
+
+Unorm8x4 VertexQuantizer::encode_unorm8x4(glm::vec4 value) {
+    return Unorm8x4{to_unorm8(value.x), to_unorm8(value.y), to_unorm8(value.z), to_unorm8(value.w)};
+}
+
+OctahedralNormal VertexQuantizer::encode_octahedral(glm::vec3 normal) {
+    // Project onto the octahedron |x|+|y|+|z| = 1 & fold the lower half over the diagonals
+    float l1_norm = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    float x = normal.x / l1_norm;
+    float y = normal.y / l1_norm;
+    if (normal.z < 0.0f) {
+        float folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+    return OctahedralNormal{to_snorm16(x), to_snorm16(y)};
+}
+
+glm::mat4 VertexQuantizer::quantize(const std::vector<Vertex>& vertices, std::vector<PackedVertex>& packed_vertices) {
+    packed_vertices.resize(vertices.size());
+    if (vertices.empty())
+        return glm::mat4(1.0f);
+
+    glm::vec3 min_position = vertices[0].position;
+    glm::vec3 max_position = vertices[0].position;
+    for (const Vertex& vertex : vertices) {
+        min_position = glm::min(min_position, vertex.position);
+        max_position = glm::max(max_position, vertex.position);
+    }
+    // Flat meshes still need a non-zero scale on every axis
+    glm::vec3 center = (min_position + max_position) * 0.5f;
+    glm::vec3 half_extent = glm::max((max_position - min_position) * 0.5f, glm::vec3(1e-6f));
+
+    for (size_t i=0; i<vertices.size(); i++) {
+        const Vertex& vertex = vertices[i];
+        glm::vec3 position = (vertex.position - center) / half_extent;
+        packed_vertices[i].position = encode_snorm16x4(glm::vec4(position, 0.0f));
+        packed_vertices[i].color = encode_unorm8x4(glm::vec4(vertex.color, 1.0f));
+        packed_vertices[i].tex_coord = encode_half2(vertex.tex_coord);
+    }
+
+    return glm::scale(glm::translate(glm::mat4(1.0f), center), half_extent);
+}
\ No newline at end of file
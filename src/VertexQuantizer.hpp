@@ -0,0 +1,30 @@
+#ifndef VERTEX_QUANTIZER_HPP
+#define VERTEX_QUANTIZER_HPP
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Vertex.hpp"
+
+// Conversion of float attributes to the packed types of VertexLayout.hpp
+namespace VertexQuantizer {
+    // IEEE 754 half-precision, rounded to nearest even. Out of range values become infinity
+    uint16_t to_half(float value);
+    // `value` is clamped to [-1,1] / [0,1]
+    int16_t to_snorm16(float value);
+    uint8_t to_unorm8(float value);
+
+    Half2 encode_half2(glm::vec2 value);
+    Half4 encode_half4(glm::vec4 value);
+    Snorm16x4 encode_snorm16x4(glm::vec4 value);
+    Unorm8x4 encode_unorm8x4(glm::vec4 value);
+    // `normal` doesn't need to be normalized, but mustn't be zero
+    OctahedralNormal encode_octahedral(glm::vec3 normal);
+
+    // Packs `vertices` into `packed_vertices`. Positions are stored relative to the bounding box of the mesh,
+    // the returned matrix transforms them back (to be applied before the model matrix)
+    glm::mat4 quantize(const std::vector<Vertex>& vertices, std::vector<PackedVertex>& packed_vertices);
+}
+
+#endif
\ No newline at end of file
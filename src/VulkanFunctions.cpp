@@ -1,13 +1,42 @@
 #include "VulkanFunctions.hpp"
 
-uint32_t find_memory_type(VulkanData vkd, uint32_t type_filter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memory_properties;
-    vkd.vkf->vkGetPhysicalDeviceMemoryProperties(vkd.physical_device, &memory_properties);
+namespace {
+    int count_bits(VkMemoryPropertyFlags flags) {
+        int count = 0;
+        for (; flags != 0; flags &= flags - 1)
+            count++;
+        return count;
+    }
+}
+
+uint32_t find_memory_type(const VkPhysicalDeviceMemoryProperties& memory_properties, uint32_t type_filter, VkMemoryPropertyFlags required,
+                          VkMemoryPropertyFlags preferred, VkDeviceSize min_heap_size) {
+    uint32_t best_type = -1;
+    int best_score = 0;
+    VkDeviceSize best_heap_size = 0;
     for (uint32_t i=0; i<memory_properties.memoryTypeCount; i++) {
-        if (type_filter & (1 << i) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties)
-            return i;
+        VkMemoryPropertyFlags flags = memory_properties.memoryTypes[i].propertyFlags;
+        VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[i].heapIndex].size;
+        if (!(type_filter & (1 << i)) || (flags & required) != required || heap_size < min_heap_size)
+            continue;
+        if ((flags & VK_MEMORY_PROPERTY_PROTECTED_BIT) && !(required & VK_MEMORY_PROPERTY_PROTECTED_BIT))
+            continue;
+
+        // A preferred flag outweighs all unrequested ones
+        int score = 32 * count_bits(flags & preferred) - count_bits(flags & ~(required | preferred));
+        if (best_type == uint32_t(-1) || score > best_score || (score == best_score && heap_size > best_heap_size)) {
+            best_type = i;
+            best_score = score;
+            best_heap_size = heap_size;
+        }
     }
-    return -1;
+    return best_type;
+}
+
+uint32_t find_memory_type(VulkanData vkd, uint32_t type_filter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkDeviceSize min_heap_size) {
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    vkd.vkf->vkGetPhysicalDeviceMemoryProperties(vkd.physical_device, &memory_properties);
+    return find_memory_type(memory_properties, type_filter, required, preferred, min_heap_size);
 }
 
 VkCommandBuffer begin_single_time_commands(VulkanData vkd, VkCommandPool command_pool) {
@@ -4,19 +4,28 @@
 #include <QVulkanInstance>
 #include <QVulkanDeviceFunctions>
 
+class MemoryAllocator;
+
 struct VulkanData {
     QVulkanInstance* instance = nullptr;
     QVulkanFunctions* vkf = nullptr;
     QVulkanDeviceFunctions* vkdf = nullptr;
     VkPhysicalDevice physical_device = VK_NULL_HANDLE;
     VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator* allocator = nullptr;
 };
 
 inline VkDeviceSize align_to(VkDeviceSize size, VkDeviceSize min_alignment) {
     return (size + min_alignment - 1) & ~(min_alignment - 1);
 }
 
-uint32_t find_memory_type(VulkanData vkd, uint32_t type_filter, VkMemoryPropertyFlags properties);
+// Index of the best memory type in `type_filter` that has all `required` flags, or -1 if there is none
+// Types are ranked by the number of `preferred` flags they have, then by the fewest other flags (so e.g. a device-local
+// host-visible (resizable BAR) type is only picked when host visibility or device locality is asked for), then by heap size
+// Types on heaps smaller than `min_heap_size` & protected types (unless required) are never picked
+uint32_t find_memory_type(const VkPhysicalDeviceMemoryProperties& memory_properties, uint32_t type_filter, VkMemoryPropertyFlags required,
+                          VkMemoryPropertyFlags preferred=0, VkDeviceSize min_heap_size=0);
+uint32_t find_memory_type(VulkanData vkd, uint32_t type_filter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred=0, VkDeviceSize min_heap_size=0);
 
 VkCommandBuffer begin_single_time_commands(VulkanData vkd, VkCommandPool command_pool);
 void end_single_time_commands(VulkanData vkd, VkCommandPool command_pool, VkQueue queue, VkCommandBuffer command_buffer, uint64_t fence_timeout=1'000'000'000);
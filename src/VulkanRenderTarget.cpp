@@ -0,0 +1,853 @@
+#include "VulkanRenderTarget.hpp"
+
+#include <QVulkanFunctions>
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <set>
+#include <cstddef>
+#include <string>
+#include <algorithm>
+
+VulkanRenderTarget::VulkanRenderTarget(AbstractVulkanRenderer* vulkan_renderer) :
+    vulkan_renderer(vulkan_renderer),
+    max_recording_threads(std::max(QThread::idealThreadCount(), 1))
+{}
+
+VkCommandBuffer VulkanRenderTarget::begin_secondary_command_buffer(uint32_t thread_index) {
+    auto& thread_command_pool = frame_resources[frame_index].thread_command_pools[thread_index];
+
+    if (thread_command_pool.nr_used == thread_command_pool.secondary_command_buffers.size()) {
+        VkCommandBufferAllocateInfo allocation_info{};
+        allocation_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocation_info.commandPool = thread_command_pool.command_pool;
+        allocation_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocation_info.commandBufferCount = 1;
+
+        VkCommandBuffer command_buffer;
+        VkResult res = vkd.vkdf->vkAllocateCommandBuffers(vkd.device, &allocation_info, &command_buffer);
+        if (res != VK_SUCCESS)
+            qFatal("VulkanRenderTarget: Failed to allocate secondary command buffer: %d", res);
+        thread_command_pool.secondary_command_buffers.push_back(command_buffer);
+    }
+    VkCommandBuffer command_buffer = thread_command_pool.secondary_command_buffers[thread_command_pool.nr_used++];
+
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass = default_render_pass;
+    inheritance_info.subpass = 0;
+    inheritance_info.framebuffer = image_resources[image_index].framebuffer;
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    VkResult res = vkd.vkdf->vkBeginCommandBuffer(command_buffer, &begin_info);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to begin secondary command buffer: %d", res);
+
+    return command_buffer;
+}
+
+VulkanRenderTarget::~VulkanRenderTarget() {
+    delete vulkan_renderer;
+}
+
+void VulkanRenderTarget::set_nr_frames_in_flight(uint32_t nr_frames) {
+    requested_nr_frames_in_flight = std::clamp(nr_frames, 1u, max_frames_in_flight);
+    if (status != Status::Ready) {
+        // Nothing is in flight
+        nr_frames_in_flight = requested_nr_frames_in_flight;
+        frame_index = 0;
+    }
+}
+
+void VulkanRenderTarget::set_present_mode(VkPresentModeKHR present_mode) {
+    if (present_mode == requested_present_mode)
+        return;
+    requested_present_mode = present_mode;
+    if (status == Status::Ready)
+        request_swap_chain_recreation();
+}
+
+void VulkanRenderTarget::set_image_count(uint32_t image_count) {
+    if (image_count == requested_image_count)
+        return;
+    requested_image_count = image_count;
+    if (status == Status::Ready)
+        request_swap_chain_recreation();
+}
+
+void VulkanRenderTarget::defer_deletion(std::function<void()> deleter) {
+    // The frame being recorded (if any) gets the next number
+    deferred_deletions.push_back(DeferredDeletion{nr_submitted_frames + 1, std::move(deleter)});
+}
+
+
+// Protected Functions:
+//=====================
+
+void VulkanRenderTarget::init_resources() {
+    vulkan_renderer->pre_init_resources(this);
+
+    vkd.instance = get_vulkan_instance();
+    vkd.vkf = vkd.instance->functions();
+
+    init_target();
+    pick_physical_device();
+    create_logical_device();
+
+    vkd.vkdf = vkd.instance->deviceFunctions(vkd.device);
+    init_target_device();
+
+    memory_allocator.create(vkd);
+    vkd.allocator = &memory_allocator;
+
+    VkResult res = pipeline_cache.create(vkd, pipeline_cache_path);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to create pipeline cache: %d", res);
+
+    res = mip_generator.create(vkd, pipeline_cache.get_vk_pipeline_cache(), physical_device_features.shaderStorageImageWriteWithoutFormat);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to create mip generator: %d", res);
+
+    create_queues();
+    create_command_pool();
+    create_frame_command_pools();
+    create_frame_descriptor_allocators();
+    create_uploader();
+
+    res = texture_streamer.create(vkd, &uploader, &mip_generator, physical_device_features);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to create texture streamer: %d", res);
+
+    res = frame_profiler.create(vkd, queue_families.graphics_family.value(), max_frames_in_flight);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to create frame profiler: %d", res);
+
+    res = descriptor_cache.create(vkd);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to create descriptor cache: %d", res);
+
+    res = uniform_allocator.create(vkd, max_frames_in_flight);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to create uniform allocator: %d", res);
+
+    // Figure these out here because we want the renderpass to be available at init_resources
+    color_format = choose_color_format();
+    depth_stencil_format = find_depth_format();
+    has_stencil = has_stencil_component(depth_stencil_format);
+
+    // (So the pipeline can be created in init_resources and doesn't have to be defered to init_swap_chain_resources)
+    create_default_render_pass();
+
+    status = Status::Device_Ready;
+    vulkan_renderer->init_resources();
+}
+
+void VulkanRenderTarget::init_swap_chain_resources() {
+    create_color_images();
+    create_depth_image();
+    create_image_views();
+    create_frame_buffers();
+
+    create_sync_objects();
+
+    status = Status::Ready;
+    vulkan_renderer->init_swap_chain_resources();
+}
+
+void VulkanRenderTarget::release_swap_chain_resources() {
+    vkd.vkdf->vkDeviceWaitIdle(vkd.device);
+
+    status = Status::Device_Ready;
+    vulkan_renderer->release_swap_chain_resources();
+    // Recreated anyway by `init_swap_chain_resources`
+    swap_chain_recreation_requested = false;
+
+    for (auto& deferred_deletion : deferred_deletions)
+        deferred_deletion.deleter();
+    deferred_deletions.clear();
+
+    depth_image.destroy();
+
+    for (auto& frame_resource : frame_resources) {
+        vkd.vkdf->vkDestroySemaphore(vkd.device, frame_resource.image_available_semaphore, nullptr);
+        frame_resource.image_available_semaphore = VK_NULL_HANDLE;
+        vkd.vkdf->vkDestroySemaphore(vkd.device, frame_resource.render_finished_semaphore, nullptr);
+        frame_resource.render_finished_semaphore = VK_NULL_HANDLE;
+        vkd.vkdf->vkDestroyFence(vkd.device, frame_resource.fence, nullptr);
+        frame_resource.fence = VK_NULL_HANDLE;
+        frame_resource.upload_wait_value = 0;
+    }
+
+    for (auto& image_resource : image_resources) {
+        vkd.vkdf->vkDestroyImageView(vkd.device, image_resource.image_view, nullptr);
+        image_resource.image_view = VK_NULL_HANDLE;
+        vkd.vkdf->vkDestroyFramebuffer(vkd.device, image_resource.framebuffer, nullptr);
+        image_resource.framebuffer = VK_NULL_HANDLE;
+        // The fence should be the same fence as one in frame_resources so no need
+        // to call vkDestroyFence; just reset the handle
+        image_resource.fence = VK_NULL_HANDLE;
+    }
+
+    destroy_color_images();
+}
+
+void VulkanRenderTarget::recreate_swap_chain() {
+    QElapsedTimer rebuild_timer;
+    rebuild_timer.start();
+    swap_chain_recreation_requested = false;
+
+    status = Status::Device_Ready;
+    vulkan_renderer->release_swap_chain_resources();
+
+    // The sync objects & everything size independent stay
+    retire_image_resources();
+    create_color_images();
+    create_depth_image();
+    create_image_views();
+    create_frame_buffers();
+
+    status = Status::Ready;
+    vulkan_renderer->init_swap_chain_resources();
+
+    swap_chain_stats.nr_rebuilds++;
+    swap_chain_stats.last_rebuild_time = rebuild_timer.nsecsElapsed() / 1e3;
+    swap_chain_stats.total_rebuild_time += swap_chain_stats.last_rebuild_time;
+}
+
+void VulkanRenderTarget::request_swap_chain_recreation() {
+    swap_chain_stats.nr_requests++;
+    if (swap_chain_recreation_requested)
+        return;
+    swap_chain_recreation_requested = true;
+    request_update();
+}
+
+void VulkanRenderTarget::release_resources() {
+    status = Status::Uninitialized;
+    vulkan_renderer->release_resources();
+    // The renderer might have deferred deletions too. Nothing is in flight anymore
+    for (auto& deferred_deletion : deferred_deletions)
+        deferred_deletion.deleter();
+    deferred_deletions.clear();
+
+    vkd.vkdf->vkDestroyCommandPool(vkd.device, command_pool, nullptr);
+    command_pool = VK_NULL_HANDLE;
+
+    for (auto& frame_resource : frame_resources) {
+        // Also frees the command buffers
+        vkd.vkdf->vkDestroyCommandPool(vkd.device, frame_resource.command_pool, nullptr);
+        frame_resource.command_pool = VK_NULL_HANDLE;
+        frame_resource.command_buffer = VK_NULL_HANDLE;
+
+        for (auto& thread_command_pool : frame_resource.thread_command_pools)
+            vkd.vkdf->vkDestroyCommandPool(vkd.device, thread_command_pool.command_pool, nullptr);
+        frame_resource.thread_command_pools.clear();
+
+        frame_resource.descriptor_allocator.destroy();
+    }
+
+    vkd.vkdf->vkDestroyRenderPass(vkd.device, default_render_pass, nullptr);
+    default_render_pass = VK_NULL_HANDLE;
+
+    uniform_allocator.destroy();
+    descriptor_cache.destroy();
+
+    frame_profiler.destroy();
+
+    texture_streamer.destroy();
+
+    uploader.destroy();
+
+    mip_generator.destroy();
+
+    pipeline_cache.destroy();
+
+    memory_allocator.destroy();
+    vkd.allocator = nullptr;
+
+    vkd.vkdf->vkDestroyDevice(vkd.device, nullptr);
+    vkd.device = VK_NULL_HANDLE;
+
+    vkd.vkf = nullptr;
+    vkd.vkdf = nullptr;
+}
+
+void VulkanRenderTarget::begin_frame() {
+    if (status != Status::Ready) {
+        qWarning("VulkanRenderTarget: Tried to begin frame with incomplete initialization: %d", int(status));
+        return;
+    }
+
+    if (requested_nr_frames_in_flight != nr_frames_in_flight)
+        apply_nr_frames_in_flight();
+    if (swap_chain_recreation_requested)
+        recreate_swap_chain();
+
+    VkResult res;
+    FrameResources& frame_resource = frame_resources[frame_index];
+
+    // qDebug() << "begin_frame";
+    QElapsedTimer fence_wait_timer;
+    fence_wait_timer.start();
+    vkd.vkdf->vkWaitForFences(vkd.device, 1, &frame_resource.fence, VK_TRUE, -1);
+    qint64 fence_wait_time = fence_wait_timer.nsecsElapsed();
+    frame_profiler.frame_finished(frame_index);
+    nr_completed_frames = std::max(nr_completed_frames, frame_resource.frame_number);
+    run_deferred_deletions();
+
+    if (!acquire_next_image(frame_resource.image_available_semaphore, image_index))
+        return;
+
+    ImageResources& image_resource = image_resources[image_index];
+
+    // Make sure previous images & frames have finished using their resources
+    if (image_resource.fence != VK_NULL_HANDLE) {
+        fence_wait_timer.start();
+        vkd.vkdf->vkWaitForFences(vkd.device, 1, &image_resource.fence, VK_TRUE, -1);
+        fence_wait_time += fence_wait_timer.nsecsElapsed();
+    }
+    image_resource.fence = frame_resource.fence;
+
+    // The frame's previous submission is done so everything allocated from its pool can be recycled at once
+    res = vkd.vkdf->vkResetCommandPool(vkd.device, frame_resource.command_pool, 0);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to reset frame command pool: %d", res);
+    for (auto& thread_command_pool : frame_resource.thread_command_pools) {
+        if (thread_command_pool.nr_used == 0)
+            continue;
+        res = vkd.vkdf->vkResetCommandPool(vkd.device, thread_command_pool.command_pool, 0);
+        if (res != VK_SUCCESS)
+            qFatal("VulkanRenderTarget: Failed to reset thread command pool: %d", res);
+        thread_command_pool.nr_used = 0;
+    }
+    frame_resource.descriptor_allocator.reset();
+    uniform_allocator.begin_frame(frame_index);
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = nullptr;
+
+    res = vkd.vkdf->vkBeginCommandBuffer(frame_resource.command_buffer, &begin_info);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to begin recording framebuffer: %d", res);
+
+    frame_profiler.begin_frame(frame_index, frame_resource.command_buffer, fence_wait_time);
+
+    // Hand finished uploads over to the graphics queue before the renderer uses them
+    uint32_t upload_scope = frame_profiler.begin_scope(frame_resource.command_buffer, "Upload acquire");
+    frame_resource.upload_wait_value = uploader.record_acquire_barriers(frame_resource.command_buffer);
+    frame_profiler.end_scope(frame_resource.command_buffer, upload_scope);
+    texture_streamer.update();
+
+    vulkan_renderer->start_next_frame();
+}
+
+void VulkanRenderTarget::end_frame() {
+    FrameResources& frame_resource = frame_resources[frame_index];
+    VkResult res;
+
+    frame_profiler.end_frame(frame_resource.command_buffer);
+
+    res = vkd.vkdf->vkEndCommandBuffer(frame_resource.command_buffer);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to end recording framebuffer: %d", res);
+
+    vkd.vkdf->vkResetFences(vkd.device, 1, &frame_resource.fence);
+    frame_resource.frame_number = ++nr_submitted_frames;
+    res = uniform_allocator.flush();
+    if (res != VK_SUCCESS)
+        qWarning("VulkanRenderTarget: Failed to flush uniform allocator: %d", res);
+
+    bool presents = uses_presentation_engine();
+
+    // The values for binary semaphores are ignored
+    std::vector<VkSemaphore> wait_semaphores;
+    std::vector<VkPipelineStageFlags> wait_stages;
+    std::vector<uint64_t> wait_values;
+    if (presents) {
+        wait_semaphores.push_back(frame_resource.image_available_semaphore);
+        wait_stages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        wait_values.push_back(0);
+    }
+    // Only wait on the uploader if acquire barriers were recorded this frame
+    if (frame_resource.upload_wait_value != 0) {
+        wait_semaphores.push_back(uploader.get_timeline_semaphore());
+        wait_stages.push_back(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+        wait_values.push_back(frame_resource.upload_wait_value);
+    }
+
+    VkTimelineSemaphoreSubmitInfo timeline_info{};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount = wait_values.size();
+    timeline_info.pWaitSemaphoreValues = wait_values.data();
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    if (frame_resource.upload_wait_value != 0)
+        submit_info.pNext = &timeline_info;
+    submit_info.waitSemaphoreCount = wait_semaphores.size();
+    submit_info.pWaitSemaphores = wait_semaphores.data();
+    submit_info.pWaitDstStageMask = wait_stages.data();
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &frame_resource.command_buffer;
+    submit_info.signalSemaphoreCount = presents ? 1 : 0;
+    submit_info.pSignalSemaphores = &frame_resource.render_finished_semaphore;
+
+    res = vkd.vkdf->vkQueueSubmit(graphics_queue, 1, &submit_info, frame_resource.fence);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to submit queue: %d", res);
+
+    present_image(presents ? frame_resource.render_finished_semaphore : VK_NULL_HANDLE, image_index);
+
+    frame_index = (frame_index + 1) % nr_frames_in_flight;
+}
+
+VulkanRenderTarget::QueueFamilyIndices VulkanRenderTarget::find_queue_families(VkPhysicalDevice device) {
+    QueueFamilyIndices indices;
+
+    uint32_t queue_family_count = 0;
+    vkd.vkf->vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> queue_family_properties(queue_family_count);
+    vkd.vkf->vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_family_properties.data());
+
+
+    for (uint32_t i=0; i<queue_family_properties.size(); i++) {
+        VkQueueFlags flags = queue_family_properties[i].queueFlags;
+        if (flags & VK_QUEUE_GRAPHICS_BIT)
+            indices.graphics_family = i;
+
+        // Prefer a pure transfer family (usually the DMA engine) over an async compute family
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            if (!(flags & VK_QUEUE_COMPUTE_BIT) || !indices.transfer_family.has_value())
+                indices.transfer_family = i;
+        }
+        
+        if (supports_present(device, i))
+            indices.present_family = i;
+    }
+
+    // Nothing is presented so the graphics queue can stand in for the present queue
+    if (!uses_presentation_engine())
+        indices.present_family = indices.graphics_family;
+
+    return indices;
+}
+
+bool VulkanRenderTarget::check_device_extension_support(VkPhysicalDevice device) {
+    uint32_t extension_count;
+    vkd.vkf->vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> available_extensions(extension_count);
+    vkd.vkf->vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
+
+    std::set<std::string> required_extensions(device_extensions.begin(), device_extensions.end());
+
+    size_t nr_unsupported_extensions = required_extensions.size();
+    for (const auto& extension : available_extensions) {
+        if (required_extensions.find(extension.extensionName) != required_extensions.end()) 
+            nr_unsupported_extensions -= 1;
+    }
+    return nr_unsupported_extensions == 0;
+}
+
+int VulkanRenderTarget::rate_device_suitability(VkPhysicalDevice device) {
+    int score = 1;
+
+    if (!find_queue_families(device).is_complete())
+        return 0;
+
+    if (!check_device_extension_support(device))
+        return 0;
+
+    if (!is_device_suitable(device))
+        return 0;
+
+    if (physical_device_rater != nullptr)
+        return physical_device_rater(device, score);
+
+    return score;
+}
+
+void VulkanRenderTarget::pick_physical_device() {
+    uint32_t device_count = 0;
+    vkd.vkf->vkEnumeratePhysicalDevices(vkd.instance->vkInstance(), &device_count, nullptr);
+    std::vector<VkPhysicalDevice> devices(device_count);
+    vkd.vkf->vkEnumeratePhysicalDevices(vkd.instance->vkInstance(), &device_count, devices.data());
+
+    int best_score = 0;
+    for (const auto& device : devices) {
+        if (rate_device_suitability(device) > best_score) {
+            vkd.physical_device = device;
+        }
+    }
+
+    if (vkd.physical_device == VK_NULL_HANDLE)
+        qFatal("VulkanRenderTarget: Unable to find suitable GPU");
+}
+
+void VulkanRenderTarget::create_logical_device() {
+    queue_families = find_queue_families(vkd.physical_device);
+
+    std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
+
+    std::set<uint32_t> unique_queue_families = {
+        queue_families.graphics_family.value(),
+        queue_families.present_family.value()
+    };
+    if (queue_families.transfer_family.has_value())
+        unique_queue_families.insert(queue_families.transfer_family.value());
+
+    float queue_priority = 1.0f;
+    for (uint32_t queue_family : unique_queue_families) {
+        VkDeviceQueueCreateInfo queue_create_info{};
+        queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queue_create_info.queueFamilyIndex = queue_family;
+        queue_create_info.queueCount = 1;
+        queue_create_info.pQueuePriorities = &queue_priority;
+
+        queue_create_infos.push_back(queue_create_info);
+    }
+
+    physical_device_features = requested_physical_device_features;
+    // For MipGenerator's compute fallback (one shader for every storage format)
+    physical_device_features.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+    VkPhysicalDeviceFeatures supported_device_features;
+    vkd.vkf->vkGetPhysicalDeviceFeatures(vkd.physical_device, &supported_device_features);
+
+    // Super unsafe but the only way I know to disable unsupported features without hardcoding an if for each feature
+    // Hopefully messing up whatever padding the compiler puts (if the compiler does put padding) doesn't cause errors
+    unsigned char* supported_device_features_memory = reinterpret_cast<unsigned char*>(&supported_device_features);
+    unsigned char* device_features_memory = reinterpret_cast<unsigned char*>(&physical_device_features);
+    if (sizeof(VkPhysicalDeviceFeatures) != 55*4)
+        qWarning("VulkanRenderTarget: Unexpected VkPhysicalDeviceFeatures size. This might be because more features were added or because padding was added by the compiler.");
+    for (size_t i=0; i<sizeof(VkPhysicalDeviceFeatures); i++) {
+        device_features_memory[i] &= supported_device_features_memory[i];
+    }
+
+    vulkan12_features = requested_vulkan12_features;
+    vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12_features.pNext = nullptr;
+    // Timeline semaphores are core in Vulkan 1.2. Without them uploads fall back to blocking on the graphics queue
+    vulkan12_features.timelineSemaphore = VK_TRUE;
+
+    VkPhysicalDeviceProperties physical_device_properties;
+    vkd.vkf->vkGetPhysicalDeviceProperties(vkd.physical_device, &physical_device_properties);
+    bool vulkan12 = physical_device_properties.apiVersion >= VK_API_VERSION_1_2 && vkd.instance->apiVersion() >= QVersionNumber(1, 2);
+    if (vulkan12) {
+        auto vkGetPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
+            vkd.instance->getInstanceProcAddr("vkGetPhysicalDeviceFeatures2")
+        );
+
+        VkPhysicalDeviceVulkan12Features supported_vulkan12_features{};
+        supported_vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 supported_features2{};
+        supported_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported_features2.pNext = &supported_vulkan12_features;
+        vkGetPhysicalDeviceFeatures2(vkd.physical_device, &supported_features2);
+
+        // Every member after sType & pNext is a VkBool32
+        VkBool32* device_vulkan12_features = &vulkan12_features.samplerMirrorClampToEdge;
+        const VkBool32* supported_device_vulkan12_features = &supported_vulkan12_features.samplerMirrorClampToEdge;
+        size_t nr_vulkan12_features = (sizeof(VkPhysicalDeviceVulkan12Features) - offsetof(VkPhysicalDeviceVulkan12Features, samplerMirrorClampToEdge)) / sizeof(VkBool32);
+        for (size_t i=0; i<nr_vulkan12_features; i++) {
+            device_vulkan12_features[i] &= supported_device_vulkan12_features[i];
+        }
+    }
+    else {
+        vulkan12_features = VkPhysicalDeviceVulkan12Features{};
+        vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    }
+
+    VkDeviceCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    if (vulkan12)
+        create_info.pNext = &vulkan12_features;
+    create_info.queueCreateInfoCount = queue_create_infos.size();
+    create_info.pQueueCreateInfos = queue_create_infos.data();
+    create_info.pEnabledFeatures = &physical_device_features;
+
+    create_info.enabledExtensionCount = device_extensions.size();
+    create_info.ppEnabledExtensionNames = device_extensions.data();
+
+    // Device layers deprecated
+    create_info.enabledLayerCount = 0;
+    create_info.ppEnabledLayerNames = nullptr;
+
+    VkResult res = vkd.vkf->vkCreateDevice(vkd.physical_device, &create_info, nullptr, &vkd.device);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to create logical device: %d", res);
+}
+
+void VulkanRenderTarget::create_queues() {
+    vkd.vkdf->vkGetDeviceQueue(vkd.device, queue_families.graphics_family.value(), 0, &graphics_queue);
+    vkd.vkdf->vkGetDeviceQueue(vkd.device, queue_families.present_family.value(), 0, &present_queue);
+    if (queue_families.transfer_family.has_value())
+        vkd.vkdf->vkGetDeviceQueue(vkd.device, queue_families.transfer_family.value(), 0, &transfer_queue);
+}
+
+void VulkanRenderTarget::create_command_pool() {
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.queueFamilyIndex = queue_families.graphics_family.value();
+    pool_info.flags = 0;
+
+    VkResult res = vkd.vkdf->vkCreateCommandPool(vkd.device, &pool_info, nullptr, &command_pool);
+    if (res != VK_SUCCESS)
+        qFatal("Failed to create command pool: %d", res);
+}
+
+void VulkanRenderTarget::create_frame_command_pools() {
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.queueFamilyIndex = queue_families.graphics_family.value();
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    for (auto& frame_resource : frame_resources) {
+        VkResult res = vkd.vkdf->vkCreateCommandPool(vkd.device, &pool_info, nullptr, &frame_resource.command_pool);
+        if (res != VK_SUCCESS)
+            qFatal("VulkanRenderTarget: Failed to create frame command pool: %d", res);
+
+        VkCommandBufferAllocateInfo allocation_info{};
+        allocation_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocation_info.commandPool = frame_resource.command_pool;
+        allocation_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocation_info.commandBufferCount = 1;
+
+        res = vkd.vkdf->vkAllocateCommandBuffers(vkd.device, &allocation_info, &frame_resource.command_buffer);
+        if (res != VK_SUCCESS)
+            qFatal("VulkanRenderTarget: Failed to allocate command buffer: %d", res);
+
+        // Secondary command buffers are allocated on demand
+        frame_resource.thread_command_pools.resize(max_recording_threads);
+        for (auto& thread_command_pool : frame_resource.thread_command_pools) {
+            res = vkd.vkdf->vkCreateCommandPool(vkd.device, &pool_info, nullptr, &thread_command_pool.command_pool);
+            if (res != VK_SUCCESS)
+                qFatal("VulkanRenderTarget: Failed to create thread command pool: %d", res);
+        }
+    }
+}
+
+void VulkanRenderTarget::create_frame_descriptor_allocators() {
+    for (auto& frame_resource : frame_resources) {
+        VkResult res = frame_resource.descriptor_allocator.create(vkd);
+        if (res != VK_SUCCESS)
+            qFatal("VulkanRenderTarget: Failed to create frame descriptor allocator: %d", res);
+    }
+}
+
+void VulkanRenderTarget::create_uploader() {
+    Uploader::CreateData ucd{};
+    ucd.graphics_family = queue_families.graphics_family.value();
+    ucd.graphics_queue = graphics_queue;
+    ucd.transfer_family = queue_families.transfer_family.value_or(ucd.graphics_family);
+    ucd.transfer_queue = queue_families.transfer_family.has_value() ? transfer_queue : graphics_queue;
+    ucd.timeline_semaphores = vulkan12_features.timelineSemaphore;
+    ucd.mip_generator = &mip_generator;
+
+    VkResult res = uploader.create(vkd, ucd);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to create uploader: %d", res);
+}
+
+int VulkanRenderTarget::find_supported_format(const VkFormat* formats, int nr_candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
+    for (int i=0; i<nr_candidates; i++) {
+        VkFormatProperties properties;
+        vkd.vkf->vkGetPhysicalDeviceFormatProperties(vkd.physical_device, formats[i], &properties);
+        if (tiling == VK_IMAGE_TILING_LINEAR && (properties.linearTilingFeatures & features) == features) {
+            return i;
+        }
+        else if (tiling == VK_IMAGE_TILING_OPTIMAL && (properties.optimalTilingFeatures & features) == features) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+VkFormat VulkanRenderTarget::find_depth_format() {
+    VkFormat depth_formats[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT};
+    int index = find_supported_format(
+        depth_formats,
+        sizeof(depth_formats)/sizeof(depth_formats[0]),
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+    );
+    if (index == -1) qFatal("Failed to find supported depth format.");
+    return depth_formats[index];
+}
+
+bool VulkanRenderTarget::has_stencil_component(VkFormat format) {
+    return format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+            format == VK_FORMAT_D24_UNORM_S8_UINT;
+}
+
+void VulkanRenderTarget::create_default_render_pass() {
+    VkAttachmentDescription color_attachment{};
+    color_attachment.format = color_format;
+    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    color_attachment.finalLayout = get_color_final_layout();
+
+    VkAttachmentReference color_attachment_reference{};
+    color_attachment_reference.attachment = 0;
+    color_attachment_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription depth_attachment{};
+    depth_attachment.format = depth_stencil_format;
+    depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depth_attachment_reference{};
+    depth_attachment_reference.attachment = 1;
+    depth_attachment_reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_attachment_reference;
+    subpass.pDepthStencilAttachment = &depth_attachment_reference;
+
+    VkSubpassDependency subpass_dependency{};
+    subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    subpass_dependency.dstSubpass = 0;
+    subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpass_dependency.srcAccessMask = 0;
+    subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    VkAttachmentDescription attachments[] = {
+        color_attachment,
+        depth_attachment,
+    };
+
+    VkRenderPassCreateInfo render_pass_create_info{};
+    render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_create_info.attachmentCount = sizeof(attachments)/sizeof(attachments[0]);
+    render_pass_create_info.pAttachments = attachments;
+    render_pass_create_info.subpassCount = 1;
+    render_pass_create_info.pSubpasses = &subpass;
+    render_pass_create_info.dependencyCount = 1;
+    render_pass_create_info.pDependencies = &subpass_dependency;
+
+    VkResult res = vkd.vkdf->vkCreateRenderPass(vkd.device, &render_pass_create_info, nullptr, &default_render_pass);
+    if (res != VK_SUCCESS)
+        qFatal("VulkanRenderTarget: Failed to create default render pass: %d", res);
+}
+
+void VulkanRenderTarget::create_depth_image() {
+    Image::CreateData icd{};
+    icd.width = image_extent.width;
+    icd.height = image_extent.height;
+    icd.format = depth_stencil_format;
+    icd.tiling = VK_IMAGE_TILING_OPTIMAL;
+    icd.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    icd.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    icd.aspect_flags = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (has_stencil) 
+        icd.aspect_flags |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+    depth_image.create(vkd, icd);
+    depth_image.create_view(VK_IMAGE_ASPECT_DEPTH_BIT);
+}
+
+void VulkanRenderTarget::create_image_views() {
+    for (auto& image_resource : image_resources) {
+        VkResult res = Image::create_view(vkd, image_resource.image, color_format, VK_IMAGE_ASPECT_COLOR_BIT, image_resource.image_view);
+        if (res != VK_SUCCESS)
+            qFatal("Failed to create image view: %d", res);
+    }
+}
+
+void VulkanRenderTarget::create_frame_buffers() {
+    for (auto& image_resource : image_resources) {
+        VkImageView attachments[] = {image_resource.image_view, depth_image.get_vk_image_view()};
+
+        VkFramebufferCreateInfo framebuffer_create_info{};
+        framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebuffer_create_info.renderPass = default_render_pass;
+        framebuffer_create_info.attachmentCount = sizeof(attachments)/sizeof(attachments[0]);
+        framebuffer_create_info.pAttachments = attachments;
+        framebuffer_create_info.width = image_extent.width;
+        framebuffer_create_info.height = image_extent.height;
+        framebuffer_create_info.layers = 1;
+
+        VkResult res = vkd.vkdf->vkCreateFramebuffer(vkd.device, &framebuffer_create_info, nullptr, &image_resource.framebuffer);
+        if (res != VK_SUCCESS)
+            qFatal("VulkanRenderTarget: Failed to create framebuffer: %d", res);
+    }
+}
+
+void VulkanRenderTarget::retire_image_resources() {
+    std::vector<ImageResources> old_image_resources = std::move(image_resources);
+    image_resources.clear();
+    Image old_depth_image = depth_image;
+    depth_image = Image{};
+
+    defer_deletion([this, old_image_resources, old_depth_image]() mutable {
+        for (auto& image_resource : old_image_resources) {
+            vkd.vkdf->vkDestroyImageView(vkd.device, image_resource.image_view, nullptr);
+            vkd.vkdf->vkDestroyFramebuffer(vkd.device, image_resource.framebuffer, nullptr);
+        }
+        old_depth_image.destroy();
+    });
+}
+
+void VulkanRenderTarget::apply_nr_frames_in_flight() {
+    std::vector<VkFence> fences;
+    for (uint32_t i=0; i<nr_frames_in_flight; i++)
+        fences.push_back(frame_resources[i].fence);
+    vkd.vkdf->vkWaitForFences(vkd.device, fences.size(), fences.data(), VK_TRUE, -1);
+
+    nr_completed_frames = nr_submitted_frames;
+    run_deferred_deletions();
+    // Slots are reassigned, their pending results would be attributed to the wrong frames
+    frame_profiler.discard_pending();
+
+    nr_frames_in_flight = requested_nr_frames_in_flight;
+    frame_index = 0;
+}
+
+void VulkanRenderTarget::run_deferred_deletions() {
+    // Deferred in order, so the frame numbers never decrease
+    while (!deferred_deletions.empty() && deferred_deletions.front().last_frame <= nr_completed_frames) {
+        deferred_deletions.front().deleter();
+        deferred_deletions.pop_front();
+    }
+}
+
+void VulkanRenderTarget::create_sync_objects() {
+    VkResult res;
+
+    VkSemaphoreCreateInfo semaphore_create_info{};
+    semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fence_create_info{};
+    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    for (auto& frame_resource : frame_resources) {
+        res = vkd.vkdf->vkCreateSemaphore(vkd.device, &semaphore_create_info, nullptr, &frame_resource.image_available_semaphore);
+        if (res != VK_SUCCESS) 
+            qFatal("VulkanRenderTarget: Failed to create semaphore: %d", res);
+
+        res = vkd.vkdf->vkCreateSemaphore(vkd.device, &semaphore_create_info, nullptr, &frame_resource.render_finished_semaphore);
+        if (res != VK_SUCCESS) 
+            qFatal("VulkanRenderTarget: Failed to create semaphore: %d", res);
+
+        res = vkd.vkdf->vkCreateFence(vkd.device, &fence_create_info, nullptr, &frame_resource.fence);
+        if (res != VK_SUCCESS)
+            qFatal("VulkanRenderTarget: Failed to create fence: %d", res);
+    }
+}
@@ -0,0 +1,423 @@
+#ifndef VULKAN_RENDER_TARGET_HPP
+#define VULKAN_RENDER_TARGET_HPP
+
+#include <QVulkanInstance>
+
+#include <functional>
+#include <optional>
+#include <deque>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include "VulkanFunctions.hpp"
+#include "Image.hpp"
+#include "MemoryAllocator.hpp"
+#include "Uploader.hpp"
+#include "PipelineCache.hpp"
+#include "MipGenerator.hpp"
+#include "TextureStreamer.hpp"
+#include "FrameProfiler.hpp"
+#include "DescriptorAllocator.hpp"
+#include "DescriptorCache.hpp"
+#include "UniformAllocator.hpp"
+
+class VulkanRenderTarget;
+
+class AbstractVulkanRenderer {
+public:
+    virtual ~AbstractVulkanRenderer() {};
+
+    virtual void pre_init_resources(VulkanRenderTarget*) {};
+    virtual void init_resources() {};
+    // Also called when the swap chain is recreated (e.g. on resize). Earlier frames can still be in flight then, so
+    // anything they use must be destroyed with `VulkanRenderTarget::defer_deletion`
+    virtual void init_swap_chain_resources() {};
+    virtual void release_swap_chain_resources() {};
+    virtual void release_resources() {};
+
+    virtual void start_next_frame() = 0;
+};
+
+// Everything a renderer needs that doesn't depend on where the frames end up: device, queues, default render pass,
+// depth buffer, framebuffers & frames-in-flight synchronization
+// Subclasses provide the color images and decide when frames are rendered (VulkanWindow: swapchain driven by Qt
+// update requests, HeadlessRenderTarget: offscreen images rendered in a loop)
+class VulkanRenderTarget {
+public:
+    VulkanRenderTarget(AbstractVulkanRenderer* vulkan_renderer);
+    virtual ~VulkanRenderTarget();
+
+    // Number of frames in flight, `get_current_frame_index()` is below it. Can change between frames (see `set_nr_frames_in_flight`)
+    uint32_t get_nr_concurrent_frames() {return nr_frames_in_flight;}
+    // Resources with a part per frame in flight should have this many parts, so they stay valid when the number changes
+    static constexpr uint32_t get_max_concurrent_frames() {return max_frames_in_flight;}
+
+    virtual QVulkanInstance* get_vulkan_instance() = 0;
+
+    // Ask for `start_next_frame` to be called again
+    virtual void request_update() = 0;
+
+
+    // Pre-init functions (only valid before `init_resources`. Usually used in `pre_init_resources`)
+    //========================================================
+
+    typedef std::function<int (VkPhysicalDevice device, int window_rating)> PhysicalDeviceRater;
+    // Rate physical device
+    // Physical devices not suitable for the render target will be discarded before reaching `get_physical_device_rating`
+    // The user provided rating will be the final rating (the user chooses how much the initial `window_rating` matters)
+    // It is recommended to only add to the score (or return 0 if the device is not suitable).
+    // The highest rated device will be chosen as the VkPhysicalDevice. It is recommended to check and make sure this device has the requested features
+    void set_physical_device_rater(PhysicalDeviceRater pdr) {physical_device_rater=pdr;}
+
+    // Request the given VkPhysicalDeviceFeatures
+    // If a feature isn't supported it will be ignored
+    // If you want to weigh devices supporting the feature more highly you must use `set_physical_device_rater` to rate it more highly yourself
+    void request_physical_device_features(const VkPhysicalDeviceFeatures& pdf) {requested_physical_device_features=pdf;}
+    // Same for the Vulkan 1.2 features (none are enabled without Vulkan 1.2). `sType` & `pNext` are ignored
+    void request_vulkan12_features(const VkPhysicalDeviceVulkan12Features& features) {requested_vulkan12_features=features;}
+
+    // File the pipeline cache is loaded from on device creation and saved to on `release_resources`
+    // An empty path disables the on-disk cache
+    void set_pipeline_cache_path(const QString& path) {pipeline_cache_path=path;}
+
+    // Number of threads that can record secondary command buffers in parallel (see `begin_secondary_command_buffer`)
+    // Defaults to QThread::idealThreadCount()
+    void set_max_recording_threads(uint32_t nr_threads) {max_recording_threads=std::max(nr_threads, 1u);}
+
+
+    // Frame pacing settings (can be changed at any time, applied at the start of the next frame)
+    //===========================================================================================
+
+    // 1 to `get_max_concurrent_frames()` (default 2). More frames in flight let the CPU run further ahead of the GPU,
+    // which evens out varying frame times at the cost of latency
+    void set_nr_frames_in_flight(uint32_t nr_frames);
+    // Used if the presentation engine supports it, otherwise VK_PRESENT_MODE_FIFO_KHR (default MAILBOX)
+    void set_present_mode(VkPresentModeKHR present_mode);
+    // Minimum number of swapchain images, clamped to what the surface supports (default 3)
+    void set_image_count(uint32_t image_count);
+
+    uint32_t get_requested_nr_frames_in_flight() {return requested_nr_frames_in_flight;}
+    VkPresentModeKHR get_requested_present_mode() {return requested_present_mode;}
+    uint32_t get_requested_image_count() {return requested_image_count;}
+
+
+    // Resource functions (only valid from `init_resources` to `release_resources`)
+    //=============================================================================
+
+    VulkanData get_vulkan_data() {return vkd;}
+
+    VkPhysicalDevice get_physical_device() {return vkd.physical_device;}
+    VkDevice get_device() {return vkd.device;}
+
+    VkPhysicalDeviceFeatures get_enabled_physical_device_features() {return physical_device_features;}
+    // All false without Vulkan 1.2
+    VkPhysicalDeviceVulkan12Features get_enabled_vulkan12_features() {return vulkan12_features;}
+
+    uint32_t get_max_recording_threads() {return max_recording_threads;}
+
+    VkFormat get_color_format() {return color_format;}
+
+    VkRenderPass get_default_render_pass() {return default_render_pass;}
+
+    VkQueue get_graphics_queue() {return graphics_queue;}
+    uint32_t get_graphics_queue_family_index() {return queue_families.graphics_family.value();}
+    // For one-off commands. Frame commands are recorded into the per-frame command buffers
+    VkCommandPool get_graphics_command_pool() {return command_pool;}
+
+    // Asynchronous uploads (on the dedicated transfer queue if there is one)
+    // Acquire barriers of finished uploads are recorded at the start of every frame's command buffer
+    Uploader* get_uploader() {return &uploader;}
+
+    // Pass `get_pipeline_cache()->get_vk_pipeline_cache()` when creating pipelines
+    PipelineCache* get_pipeline_cache() {return &pipeline_cache;}
+
+    // Used by the uploader for images with more than one mip level
+    // Check `can_generate` & add `get_required_usage` when choosing the mip levels & usage of a texture
+    MipGenerator* get_mip_generator() {return &mip_generator;}
+
+    // Loads textures on worker threads & uploads them in the background. Updated at the start of every frame
+    TextureStreamer* get_texture_streamer() {return &texture_streamer;}
+
+    // CPU, fence wait & GPU times of finished frames. Use `begin_scope`/`end_scope` to time parts of a frame
+    FrameProfiler* get_frame_profiler() {return &frame_profiler;}
+
+    // Descriptor sets that live until `release_resources` (or `clear`), shared between identical requests
+    DescriptorCache* get_descriptor_cache() {return &descriptor_cache;}
+    // Uniform data of the current frame, recycled once the frame's fence has signaled
+    UniformAllocator* get_uniform_allocator() {return &uniform_allocator;}
+
+    // Calls `deleter` once every frame that was submitted or is being recorded has finished, so it can destroy
+    // resources those frames might use without waiting for the device to be idle
+    // Checked at the start of every frame, everything left is deleted by `release_swap_chain_resources`
+    void defer_deletion(std::function<void()> deleter);
+
+
+    // Swap chain functions (only valid from `init_swap_chain_resources` to `release_swap_chain_resources`)
+    //=====================================================================================================
+
+    // See: `get_nr_concurrent_frames()`
+    uint32_t get_nr_concurrent_images() {return image_count;}
+    // The present mode in use. VK_PRESENT_MODE_IMMEDIATE_KHR if the images aren't presented
+    VkPresentModeKHR get_present_mode() {return present_mode;}
+
+    // Get image size
+    VkExtent2D get_image_extent() {return image_extent;}
+
+    // All times in µs
+    struct SwapChainStats {
+        uint32_t nr_rebuilds = 0;
+        uint32_t nr_requests = 0; // Rebuild requests (e.g. resize events), coalesced into at most one rebuild per frame
+        double last_rebuild_time = 0.0;
+        double total_rebuild_time = 0.0;
+    };
+    // Counted over the render target's lifetime
+    SwapChainStats get_swap_chain_stats() {return swap_chain_stats;}
+
+
+    // Frame functions (only valid after `start_next_frame` and before `frame_ready` is called)
+    //=========================================================================================
+
+    uint32_t get_current_image_index() {return image_index;}
+    uint32_t get_current_frame_index() {return frame_index;}
+
+    VkImage get_current_image() {return image_resources[image_index].image;}
+    VkImageView get_current_image_view() {return image_resources[image_index].image_view;}
+
+    VkCommandBuffer get_current_command_buffer() {return frame_resources[frame_index].command_buffer;}
+    // For descriptor sets only used by the current frame. All of them are freed once the frame's fence has signaled
+    DescriptorAllocator* get_current_descriptor_allocator() {return &frame_resources[frame_index].descriptor_allocator;}
+    VkFramebuffer get_current_frame_buffer() {return image_resources[image_index].framebuffer;}
+
+    // Begin a secondary command buffer that continues the default render pass in the current framebuffer
+    // Each `thread_index` (< `get_max_recording_threads()`) has its own command pool per frame, so different threads can
+    // call this concurrently as long as they use different indices. Any number of buffers can be taken per thread
+    // Dynamic state isn't inherited: set the viewport & scissor in every secondary command buffer
+    // End the buffer with vkEndCommandBuffer and execute it from the primary command buffer with vkCmdExecuteCommands
+    // inside a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+    VkCommandBuffer begin_secondary_command_buffer(uint32_t thread_index);
+
+    // Should be called every time `start_next_frame` is called after finishing frame commands
+    void frame_ready() {end_frame();}
+
+
+protected:
+    void init_resources();
+    void init_swap_chain_resources();
+    void release_swap_chain_resources();
+    void release_resources();
+    // Replace the size dependent resources (color images, depth image, framebuffers) without waiting for the device
+    // to be idle. The old ones are destroyed once the frames in flight have finished
+    // Only valid when the swap chain resources are initialized
+    void recreate_swap_chain();
+    // Recreate the swap chain at the start of the next frame. Any number of requests before then cause a single rebuild,
+    // until which frames keep rendering to the current images
+    void request_swap_chain_recreation();
+
+    void begin_frame();
+    void end_frame();
+
+    enum class Status {
+        Uninitialized = 0,
+        Device_Ready = 1,
+        Ready = 2
+    };
+    Status status = Status::Uninitialized;
+
+
+    // Render target specific parts
+    //=============================
+
+    // Called before the physical device is picked (e.g. to create the surface)
+    virtual void init_target() {}
+    // Called once the logical device exists (e.g. to resolve device extension functions)
+    virtual void init_target_device() {}
+
+    // Physical devices not suitable for the target are discarded
+    virtual bool is_device_suitable(VkPhysicalDevice) {return true;}
+    // False if the images aren't handed to a presentation engine. No acquire/present semaphores are used and no
+    // present queue is needed
+    virtual bool uses_presentation_engine() = 0;
+    virtual bool supports_present(VkPhysicalDevice device, uint32_t queue_family) = 0;
+
+    virtual VkFormat choose_color_format() = 0;
+    // Layout the color attachment is left in by the default render pass
+    virtual VkImageLayout get_color_final_layout() = 0;
+
+    // Set `image_extent`, `image_count` and the `image` of every `image_resources` entry
+    // When called from `recreate_swap_chain` the previous images still exist & must be retired with `defer_deletion`
+    virtual void create_color_images() = 0;
+    // Only the images themselves. Views, framebuffers & command buffers are destroyed by `release_swap_chain_resources`
+    virtual void destroy_color_images() = 0;
+
+    // Returns false if the frame has to be skipped
+    // `image_available_semaphore` must be signaled if `uses_presentation_engine` returns true
+    virtual bool acquire_next_image(VkSemaphore image_available_semaphore, uint32_t& image_index) = 0;
+    // `render_finished_semaphore` is VK_NULL_HANDLE if `uses_presentation_engine` returns false
+    virtual void present_image(VkSemaphore render_finished_semaphore, uint32_t image_index) = 0;
+
+    VulkanData vkd{};
+
+    struct QueueFamilyIndices {
+        std::optional<uint32_t> graphics_family;
+        std::optional<uint32_t> present_family;
+        std::optional<uint32_t> transfer_family; // Only set if there is a transfer-only family (dedicated DMA engine)
+
+        bool is_complete() {
+            return graphics_family.has_value() && present_family.has_value();
+        }
+    };
+    QueueFamilyIndices queue_families{};
+
+    std::vector<const char*> device_extensions;
+
+    VkQueue graphics_queue = VK_NULL_HANDLE;
+    VkQueue present_queue = VK_NULL_HANDLE;
+
+    VkFormat color_format = VK_FORMAT_UNDEFINED;
+
+    static constexpr uint32_t max_frames_in_flight = 4;
+    uint32_t nr_frames_in_flight = 2;
+    uint32_t image_count = 0;
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    VkExtent2D image_extent{};
+    // Set by the frame pacing settings, the swapchain is created with them as far as the surface supports
+    uint32_t requested_nr_frames_in_flight = 2;
+    VkPresentModeKHR requested_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    uint32_t requested_image_count = 3;
+
+    struct ImageResources {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView image_view = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+    };
+    std::vector<ImageResources> image_resources;
+
+    uint32_t image_index;
+    uint32_t frame_index = 0;
+
+
+private:
+    AbstractVulkanRenderer* vulkan_renderer;
+
+    // Pre-init Resources (only valid before `init_resources`. In practice: set from `pre_init_resources`)
+    //====================================================================================================
+
+    PhysicalDeviceRater physical_device_rater = nullptr;
+    VkPhysicalDeviceFeatures requested_physical_device_features{};
+    VkPhysicalDeviceVulkan12Features requested_vulkan12_features{};
+    QString pipeline_cache_path = "pipeline_cache.bin";
+    uint32_t max_recording_threads;
+
+
+    // Resource Initialization (only valid from `init_resources` to `release_resources`)
+    //==================================================================================
+
+    QueueFamilyIndices find_queue_families(VkPhysicalDevice device);
+
+    bool check_device_extension_support(VkPhysicalDevice device);
+    int rate_device_suitability(VkPhysicalDevice device);
+    void pick_physical_device();
+
+    void create_logical_device();
+    VkPhysicalDeviceFeatures physical_device_features{};
+    VkPhysicalDeviceVulkan12Features vulkan12_features{}; // The requested ones & timelineSemaphore (if supported)
+
+    MemoryAllocator memory_allocator{};
+    PipelineCache pipeline_cache{};
+    MipGenerator mip_generator{};
+
+    void create_queues();
+    VkQueue transfer_queue = VK_NULL_HANDLE;
+
+    void create_uploader();
+    Uploader uploader{};
+    TextureStreamer texture_streamer{};
+
+    FrameProfiler frame_profiler{};
+
+    DescriptorCache descriptor_cache{};
+
+    UniformAllocator uniform_allocator{};
+
+    void create_command_pool();
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+
+    // One pool per frame in flight (plus one per recording thread), reset as a whole once the frame's fence has signaled
+    void create_frame_command_pools();
+    // Same for descriptor sets
+    void create_frame_descriptor_allocators();
+
+    // Returns the index of the first supported format
+    // Will return -1 if a supported format cannot be found
+    int find_supported_format(const VkFormat* formats, int nr_candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+    VkFormat find_depth_format();
+    // Only checks the format candidates in `find_depth_format`
+    // DO NOT USE THIS FUNCTION FOR CHECKING IF A RANDOM FORMAT HAS A STENCIL COMPONENT
+    bool has_stencil_component(VkFormat format);
+    // Might not have stencil part if unsupported
+    VkFormat depth_stencil_format;
+    bool has_stencil;
+
+    void create_default_render_pass();
+    VkRenderPass default_render_pass = VK_NULL_HANDLE;
+
+
+    // Swap Chain Initialization (only valid from `init_swap_chain_resources` to `release_swap_chain_resources`)
+    //==========================================================================================================
+
+    void create_depth_image();
+    Image depth_image{};
+
+    void create_image_views();
+    void create_frame_buffers();
+    // Hands the views, framebuffers & depth image to `defer_deletion` & clears `image_resources`
+    void retire_image_resources();
+
+    struct FrameResources {
+        VkSemaphore image_available_semaphore = VK_NULL_HANDLE;
+        VkSemaphore render_finished_semaphore = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        uint64_t upload_wait_value = 0; // Uploader timeline value the frame's submission waits on
+        uint64_t frame_number = 0; // Of the frame's last submission (see `nr_submitted_frames`)
+
+        // Valid from `init_resources` to `release_resources`. The command buffer is reused every frame
+        VkCommandPool command_pool = VK_NULL_HANDLE;
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+
+        struct ThreadCommandPool {
+            VkCommandPool command_pool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> secondary_command_buffers; // Kept across frames
+            size_t nr_used = 0;
+        };
+        std::vector<ThreadCommandPool> thread_command_pools;
+
+        // Valid from `init_resources` to `release_resources`
+        DescriptorAllocator descriptor_allocator{};
+    };
+    // Only the first `nr_frames_in_flight` are used
+    std::array<FrameResources, max_frames_in_flight> frame_resources{};
+
+    void create_sync_objects();
+
+    // Waits for the frames in flight (not the whole device) & restarts the frame indices at 0
+    void apply_nr_frames_in_flight();
+
+    struct DeferredDeletion {
+        uint64_t last_frame; // Last frame that might use the resources
+        std::function<void()> deleter;
+    };
+    std::deque<DeferredDeletion> deferred_deletions;
+    // Frames are numbered from 1 in submission order. Frames finish in order, so all frames up to the last one whose
+    // fence was waited on are done
+    uint64_t nr_submitted_frames = 0;
+    uint64_t nr_completed_frames = 0;
+    void run_deferred_deletions();
+
+    bool swap_chain_recreation_requested = false;
+    SwapChainStats swap_chain_stats{};
+
+};
+
+#endif
\ No newline at end of file
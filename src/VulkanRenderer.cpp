@@ -1,14 +1,22 @@
 #include "VulkanRenderer.hpp"
 
 #include <QVulkanDeviceFunctions>
+#include <QtConcurrent>
+#include <QFuture>
 #include <QFile>
 #include <QString>
+#include <QStringList>
 #include <QDebug>
 
+#include <algorithm>
+
 #include "Shader.hpp"
 #include "Vertex.hpp"
+#include "MeshOptimizer.hpp"
+#include "VertexQuantizer.hpp"
 
-const std::vector<Vertex> vertices = {
+// Drawn when no mesh is set or it fails to load
+const std::vector<Vertex> default_vertices = {
     Vertex{glm::vec3(-0.5f,-0.5f, 0.0f), glm::vec3(1.0f,0.0f,0.0f), glm::vec2(0.0f,0.0f)},
     Vertex{glm::vec3( 0.5f,-0.5f, 0.0f), glm::vec3(0.0f,1.0f,0.0f), glm::vec2(1.0f,0.0f)},
     Vertex{glm::vec3( 0.5f, 0.5f, 0.0f), glm::vec3(0.0f,0.0f,1.0f), glm::vec2(1.0f,1.0f)},
@@ -20,7 +28,7 @@ const std::vector<Vertex> vertices = {
     Vertex{glm::vec3(-0.5f, 0.5f, 1.0f), glm::vec3(1.0f,1.0f,1.0f), glm::vec2(0.0f,1.0f)},
 };
 
-const std::vector<Index> indices = {
+const std::vector<Index> default_indices = {
     0, 1, 2,
     2, 3, 0,
 
@@ -28,19 +36,47 @@ const std::vector<Index> indices = {
     6, 7, 4,
 };
 
-VulkanRenderer::VulkanRenderer() {}
+namespace {
+    // Matches `CullParameters` in cull.comp.glsl
+    struct CullPushConstants {
+        glm::vec4 planes[6];
+        uint32_t nr_objects;
+        uint32_t index_count;
+        uint32_t first_command;
+        uint32_t count_index;
+    };
+
+    const uint32_t culling_workgroup_size = 64;
+}
+
+VulkanRenderer::VulkanRenderer() {
+    // The render target applies the frame pacing settings at the start of the next frame
+    QObject::connect(&control_panel, &ControlPanel::nr_frames_in_flight_changed, &control_panel, [this](uint32_t nr_frames) {
+        if (render_target != nullptr)
+            render_target->set_nr_frames_in_flight(nr_frames);
+    });
+    QObject::connect(&control_panel, &ControlPanel::present_mode_changed, &control_panel, [this](VkPresentModeKHR present_mode) {
+        if (render_target != nullptr)
+            render_target->set_present_mode(present_mode);
+    });
+    QObject::connect(&control_panel, &ControlPanel::image_count_changed, &control_panel, [this](uint32_t image_count) {
+        if (render_target != nullptr)
+            render_target->set_image_count(image_count);
+    });
+}
 
 VulkanRenderer::~VulkanRenderer() {}
 
-void VulkanRenderer::pre_init_resources(VulkanWindow* vulkan_window) {
+void VulkanRenderer::pre_init_resources(VulkanRenderTarget* render_target) {
     fps_timer.start();
+    startup_timer.start();
 
     qDebug() << "pre_init_resources";
-    this->vulkan_window = vulkan_window;
+    this->render_target = render_target;
 
-    QVulkanFunctions* vkf = vulkan_window->vulkanInstance()->functions();
+    QVulkanFunctions* vkf = render_target->get_vulkan_instance()->functions();
         
-    vulkan_window->set_physical_device_rater(
+    render_target->set_physical_device_rater(
         [vkf](VkPhysicalDevice phys_dev, int window_score){
             VkPhysicalDeviceFeatures device_features;
             vkf->vkGetPhysicalDeviceFeatures(phys_dev, &device_features);
@@ -52,39 +88,63 @@ void VulkanRenderer::pre_init_resources(VulkanWindow* vulkan_window) {
 
     VkPhysicalDeviceFeatures requested_physical_device_features{};
     requested_physical_device_features.samplerAnisotropy = VK_TRUE;
-    vulkan_window->request_physical_device_features(requested_physical_device_features);
+    // Whichever is supported decides which compressed texture gets loaded
+    requested_physical_device_features.textureCompressionBC = VK_TRUE;
+    requested_physical_device_features.textureCompressionASTC_LDR = VK_TRUE;
+    requested_physical_device_features.textureCompressionETC2 = VK_TRUE;
+    // GPU culling draws one indirect command per visible object, each selecting its instance with firstInstance
+    requested_physical_device_features.multiDrawIndirect = VK_TRUE;
+    requested_physical_device_features.drawIndirectFirstInstance = VK_TRUE;
+    render_target->request_physical_device_features(requested_physical_device_features);
+
+    VkPhysicalDeviceVulkan12Features requested_vulkan12_features{};
+    // For GPU culling (vkCmdDrawIndexedIndirectCount)
+    requested_vulkan12_features.drawIndirectCount = VK_TRUE;
+    TextureTable::add_required_features(requested_vulkan12_features);
+    render_target->request_vulkan12_features(requested_vulkan12_features);
 }
 
 void VulkanRenderer::init_resources() {
     qDebug() << "init_resources";
-    vkd = vulkan_window->get_vulkan_data();
-    enabled_device_features = vulkan_window->get_enabled_physical_device_features();
+    vkd = render_target->get_vulkan_data();
+    enabled_device_features = render_target->get_enabled_physical_device_features();
 
     create_descriptor_set_layout();
+    create_texture_table();
     create_graphics_pipeline();
+    create_culling_pipeline();
+    set_culling_mode(culling_mode);
+    load_mesh();
     create_vertex_buffer();
-    create_texture_image();
+    create_transforms();
+    create_instance_buffers();
+    create_descriptor_sets();
+    create_culling_descriptor_set();
+    request_texture();
+    upload_value = render_target->get_uploader()->flush();
+
+    bool warm_cache = render_target->get_pipeline_cache()->is_warm();
+    qint64 startup_time = startup_timer.nsecsElapsed();
+    qDebug() << "Startup:" << startup_time / 1000 << "us, pipeline creation:" << pipeline_creation_time / 1000
+             << "us" << (warm_cache ? "(warm pipeline cache)" : "(cold pipeline cache)");
 
+    control_panel.update_startup_stats(startup_time, pipeline_creation_time, warm_cache);
+    control_panel.update_memory_stats(vkd.allocator->get_stats());
     control_panel.show();
 }
 
 void VulkanRenderer::init_swap_chain_resources() {
     qDebug() << "init_swap_chain_resources";
 
-    // Shouldn't change but just in case
-    create_descriptor_pool();
-    create_uniform_buffers();
-    create_descriptor_sets();
+    control_panel.update_memory_stats(vkd.allocator->get_stats());
+    control_panel.set_pacing_settings(
+        render_target->get_requested_nr_frames_in_flight(), render_target->get_requested_present_mode(),
+        render_target->get_requested_image_count()
+    );
 }
 
 void VulkanRenderer::release_swap_chain_resources() {
     qDebug() << "release_swap_chain_resources";
-
-    vkd.vkdf->vkUnmapMemory(vkd.device, uniform_buffer.get_vk_buffer_memory());
-    uniform_buffer.destroy();
-
-    vkd.vkdf->vkDestroyDescriptorPool(vkd.device, descriptor_pool, nullptr);
-    descriptor_pool = VK_NULL_HANDLE;
 }
 
 void VulkanRenderer::release_resources() {
@@ -92,13 +152,32 @@ void VulkanRenderer::release_resources() {
 
     control_panel.hide();
 
-    texture_image.destroy();
-
     vertex_buffer.destroy();
     index_buffer.destroy();
+    instance_buffer.destroy();
+    indirect_buffer.destroy();
+    visible_instance_buffer.destroy();
+    visible_indirect_buffer.destroy();
+    frustum_culler.clear();
+    transforms.clear();
+    bounds_buffer.destroy();
+    gpu_draw_command_buffer.destroy();
+    gpu_draw_count_buffer.destroy();
+    // The cached sets refer to the destroyed buffers
+    render_target->get_descriptor_cache()->clear();
+    descriptor_set = VK_NULL_HANDLE;
+    culling_descriptor_set = VK_NULL_HANDLE;
+    vkd.vkdf->vkDestroyPipeline(vkd.device, culling_pipeline, nullptr);
+    culling_pipeline = VK_NULL_HANDLE;
+    vkd.vkdf->vkDestroyPipelineLayout(vkd.device, culling_pipeline_layout, nullptr);
+    culling_pipeline_layout = VK_NULL_HANDLE;
+    vkd.vkdf->vkDestroyDescriptorSetLayout(vkd.device, culling_descriptor_set_layout, nullptr);
+    culling_descriptor_set_layout = VK_NULL_HANDLE;
+    vkCmdDrawIndexedIndirectCount = nullptr;
 
     vkd.vkdf->vkDestroyDescriptorSetLayout(vkd.device, descriptor_set_layout, nullptr);
     descriptor_set_layout = VK_NULL_HANDLE;
+    texture_table.destroy();
 
     vkd.vkdf->vkDestroyPipeline(vkd.device, graphics_pipeline, nullptr);
     graphics_pipeline = VK_NULL_HANDLE;
@@ -111,15 +190,54 @@ void VulkanRenderer::release_resources() {
     vkd.vkdf = nullptr;
 }
 
+void VulkanRenderer::set_recording_threads(uint32_t nr_threads) {
+    nr_recording_threads = std::max(nr_threads, 1u);
+    if (render_target != nullptr)
+        nr_recording_threads = std::min(nr_recording_threads, render_target->get_max_recording_threads());
+    reset_record_stats();
+}
+
+void VulkanRenderer::set_culling_mode(CullingMode culling_mode) {
+    if (culling_mode == CullingMode::Gpu && vkd.device != VK_NULL_HANDLE && culling_pipeline == VK_NULL_HANDLE) {
+        qWarning("GPU culling isn't supported, falling back to CPU culling");
+        culling_mode = CullingMode::Cpu;
+    }
+    this->culling_mode = culling_mode;
+}
+
 void VulkanRenderer::start_next_frame() {
-    int frame_time = fps_timer.elapsed();
+    qint64 frame_time = fps_timer.nsecsElapsed();
     control_panel.update_frame_time(frame_time);
     fps_timer.start();
 
-    VkCommandBuffer command_buffer = vulkan_window->get_current_command_buffer();
+    FrameProfiler* frame_profiler = render_target->get_frame_profiler();
+    control_panel.update_frame_profile(frame_profiler->get_results());
+    control_panel.update_swap_chain_stats(render_target->get_swap_chain_stats());
+    control_panel.update_pacing_stats(
+        render_target->get_nr_concurrent_frames(), render_target->get_present_mode(), render_target->get_nr_concurrent_images(),
+        frame_profiler->get_results().latency, frame_time
+    );
+
+    VkCommandBuffer command_buffer = render_target->get_current_command_buffer();
+
+    uint32_t current_frame_index = render_target->get_current_frame_index();
+    update_uniform_buffer();
+    if (culling_mode == CullingMode::Cpu)
+        cull_instances(current_frame_index);
+
+    // Written to a new slot, the placeholder's slot may still be in use by the previous frame
+    TextureStreamer* texture_streamer = render_target->get_texture_streamer();
+    if (texture_slot == placeholder_slot && texture_streamer->is_resident(texture)) {
+        Image& texture_image = texture_streamer->get_image(texture);
+        uint32_t slot = texture_table.add(texture_image.get_vk_image_view(), texture_image.get_vk_sampler());
+        if (slot != TextureTable::invalid_slot)
+            texture_slot = slot;
+    }
 
-    uint32_t current_frame_index = vulkan_window->get_current_frame_index();
-    update_uniform_buffer(current_frame_index);
+    // Only clear until the geometry & texture have been uploaded
+    bool draw = render_target->get_uploader()->is_ready(upload_value);
+    if (draw && culling_mode == CullingMode::Gpu)
+        record_gpu_culling(command_buffer, current_frame_index);
 
     static float green = 0.0f;
     green += 0.005f;
@@ -128,7 +246,71 @@ void VulkanRenderer::start_next_frame() {
     clear_values[0].color = {0.0f, green, 0.0f, 1.0f};
     clear_values[1].depthStencil = {1.0f, 0};
 
-    VkExtent2D extent = vulkan_window->get_image_extent();
+    uint32_t nr_frame_draws = culling_mode == CullingMode::Cpu ? visible_instances.size() : nr_draws;
+    // An indirect draw is a single command, not worth splitting
+    bool single_command = draw_mode == DrawMode::Indirect || culling_mode == CullingMode::Gpu;
+    uint32_t nr_threads = single_command ? 1 : std::min(nr_recording_threads, std::min(nr_frame_draws, render_target->get_max_recording_threads()));
+    bool use_secondary_command_buffers = draw && nr_threads > 1;
+
+    VkRenderPassBeginInfo render_pass_begin_info{};
+    render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_begin_info.renderPass = render_target->get_default_render_pass();
+    render_pass_begin_info.framebuffer = render_target->get_current_frame_buffer();
+    render_pass_begin_info.renderArea.extent = render_target->get_image_extent();
+    render_pass_begin_info.clearValueCount = sizeof(clear_values)/sizeof(clear_values[0]);
+    render_pass_begin_info.pClearValues = clear_values;
+
+    uint32_t render_pass_scope = frame_profiler->begin_scope(command_buffer, "Render pass");
+    vkd.vkdf->vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info,
+        use_secondary_command_buffers ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+
+    if (draw) {
+        QElapsedTimer record_timer;
+        record_timer.start();
+
+        if (use_secondary_command_buffers) {
+            // Every thread records its share of the draws into its own secondary command buffer
+            std::vector<VkCommandBuffer> secondary_command_buffers(nr_threads);
+            std::vector<QFuture<void>> futures;
+            futures.reserve(nr_threads - 1);
+            for (uint32_t thread_index=0; thread_index<nr_threads; thread_index++) {
+                uint32_t first_draw = uint64_t(nr_frame_draws) * thread_index / nr_threads;
+                uint32_t draw_count = uint64_t(nr_frame_draws) * (thread_index+1) / nr_threads - first_draw;
+                auto record = [this, &secondary_command_buffers, thread_index, first_draw, draw_count, current_frame_index]() {
+                    VkCommandBuffer secondary_command_buffer = render_target->begin_secondary_command_buffer(thread_index);
+                    record_draws(secondary_command_buffer, first_draw, draw_count, current_frame_index);
+                    VkResult res = vkd.vkdf->vkEndCommandBuffer(secondary_command_buffer);
+                    if (res != VK_SUCCESS)
+                        qFatal("Failed to record secondary command buffer: %d", res);
+                    secondary_command_buffers[thread_index] = secondary_command_buffer;
+                };
+                // The render thread records the last range itself
+                if (thread_index+1 < nr_threads)
+                    futures.push_back(QtConcurrent::run(record));
+                else
+                    record();
+            }
+            for (auto& future : futures)
+                future.waitForFinished();
+
+            vkd.vkdf->vkCmdExecuteCommands(command_buffer, secondary_command_buffers.size(), secondary_command_buffers.data());
+        }
+        else {
+            record_draws(command_buffer, 0, nr_frame_draws, current_frame_index);
+        }
+
+        total_record_time += record_timer.nsecsElapsed();
+        nr_recorded_frames++;
+    }
+    vkd.vkdf->vkCmdEndRenderPass(command_buffer);
+    frame_profiler->end_scope(command_buffer, render_pass_scope);
+
+    render_target->frame_ready();
+    render_target->request_update();
+}
+
+void VulkanRenderer::record_draws(VkCommandBuffer command_buffer, uint32_t first_draw, uint32_t draw_count, uint32_t current_frame_index) {
+    VkExtent2D extent = render_target->get_image_extent();
 
     VkViewport viewport{};
     viewport.x = 0.0f;
@@ -145,30 +327,39 @@ void VulkanRenderer::start_next_frame() {
     vkd.vkdf->vkCmdSetViewport(command_buffer, 0, 1, &viewport);
     vkd.vkdf->vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
-    VkRenderPassBeginInfo render_pass_begin_info{};
-    render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    render_pass_begin_info.renderPass = vulkan_window->get_default_render_pass();
-    render_pass_begin_info.framebuffer = vulkan_window->get_current_frame_buffer();
-    render_pass_begin_info.renderArea.extent = vulkan_window->get_image_extent();
-    render_pass_begin_info.clearValueCount = sizeof(clear_values)/sizeof(clear_values[0]);
-    render_pass_begin_info.pClearValues = clear_values;
-
-    vkd.vkdf->vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
     vkd.vkdf->vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
 
     vkd.vkdf->vkCmdBindIndexBuffer(command_buffer, index_buffer.get_vk_buffer(), 0, VK_INDEX_TYPE_UINT32);
-    VkDeviceSize offsets[] = {0};
-    VkBuffer vk_vertex_buffer = vertex_buffer.get_vk_buffer();
-    vkd.vkdf->vkCmdBindVertexBuffers(command_buffer, 0, 1, &vk_vertex_buffer, offsets);
-
-    uint32_t dynamic_uniform_buffer_offset = current_frame_index * aligned_size;
-    vkd.vkdf->vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_set, 1, &dynamic_uniform_buffer_offset);
-
-    vkd.vkdf->vkCmdDrawIndexed(command_buffer, indices.size(), 1, 0, 0, 0);
-    vkd.vkdf->vkCmdEndRenderPass(command_buffer);
-
-    vulkan_window->frame_ready();
-    vulkan_window->requestUpdate();
+    // With CPU culling the visible objects' instance data & draw command are in this frame's region of the visible buffers
+    bool cpu_culled = culling_mode == CullingMode::Cpu;
+    VkDeviceSize offsets[] = {0, cpu_culled ? current_frame_index * visible_instance_region_size : 0};
+    VkBuffer vk_vertex_buffers[] = {vertex_buffer.get_vk_buffer(), cpu_culled ? visible_instance_buffer.get_vk_buffer() : instance_buffer.get_vk_buffer()};
+    vkd.vkdf->vkCmdBindVertexBuffers(command_buffer, 0, 2, vk_vertex_buffers, offsets);
+
+    VkDescriptorSet descriptor_sets[] = {descriptor_set, texture_table.get_descriptor_set()};
+    vkd.vkdf->vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 2, descriptor_sets, 1, &ubo_offset);
+    vkd.vkdf->vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(draw_constants), &draw_constants);
+
+    if (culling_mode == CullingMode::Gpu) {
+        // The culling pass wrote one command per visible object & their count
+        vkCmdDrawIndexedIndirectCount(
+            command_buffer,
+            gpu_draw_command_buffer.get_vk_buffer(), VkDeviceSize(current_frame_index) * nr_draws * sizeof(VkDrawIndexedIndirectCommand),
+            gpu_draw_count_buffer.get_vk_buffer(), current_frame_index * sizeof(uint32_t),
+            nr_draws, sizeof(VkDrawIndexedIndirectCommand)
+        );
+    }
+    else if (draw_mode == DrawMode::Indirect) {
+        if (cpu_culled)
+            vkd.vkdf->vkCmdDrawIndexedIndirect(command_buffer, visible_indirect_buffer.get_vk_buffer(), current_frame_index * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+        else
+            vkd.vkdf->vkCmdDrawIndexedIndirect(command_buffer, indirect_buffer.get_vk_buffer(), 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+    }
+    else {
+        // The instance index selects the object's instance data
+        for (uint32_t i=first_draw; i<first_draw+draw_count; i++)
+            vkd.vkdf->vkCmdDrawIndexed(command_buffer, mesh.indices.size(), 1, 0, 0, i);
+    }
 }
 
 void VulkanRenderer::create_descriptor_set_layout() {
@@ -179,16 +370,9 @@ void VulkanRenderer::create_descriptor_set_layout() {
     ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     ubo_layout_binding.pImmutableSamplers = nullptr;
 
-    VkDescriptorSetLayoutBinding sampler_layout_binding{};
-    sampler_layout_binding.binding = 1;
-    sampler_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    sampler_layout_binding.descriptorCount = 1;
-    sampler_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    sampler_layout_binding.pImmutableSamplers = nullptr;
-
+    // Textures are in the texture table's set
     VkDescriptorSetLayoutBinding bindings[] = {
         ubo_layout_binding,
-        sampler_layout_binding,
     };
 
     VkDescriptorSetLayoutCreateInfo layout_create_info{};
@@ -205,20 +389,29 @@ void VulkanRenderer::create_graphics_pipeline() {
     VkResult res;
 
     ShaderModule vertex_shader_module(vkd.device, vkd.vkdf, "src/shaders/vert.spv");
-    ShaderModule fragment_shader_module(vkd.device, vkd.vkdf, "src/shaders/frag.spv");
+    // The texture table's set layout decides how the fragment shader samples it
+    ShaderModule fragment_shader_module(vkd.device, vkd.vkdf,
+        texture_table.is_single_texture() ? "src/shaders/frag_single_texture.spv" : "src/shaders/frag.spv");
 
     VkPipelineShaderStageCreateInfo shader_stages[] = {
         vertex_shader_module.get_create_info(VK_SHADER_STAGE_VERTEX_BIT),
         fragment_shader_module.get_create_info(VK_SHADER_STAGE_FRAGMENT_BIT),
     };
 
-    auto binding_description = Vertex::get_binding_description();
-    auto attribute_descriptions = Vertex::get_attribute_descriptions();
+    // Binding 0: per vertex, binding 1: per instance
+    VkVertexInputBindingDescription binding_descriptions[] = {
+        quantize_vertices ? VertexLayout<PackedVertex>::get_binding_description() : VertexLayout<Vertex>::get_binding_description(),
+        VertexLayout<InstanceData>::get_binding_description(1, VK_VERTEX_INPUT_RATE_INSTANCE),
+    };
+    auto vertex_attribute_descriptions = quantize_vertices ? VertexLayout<PackedVertex>::get_attribute_descriptions() : VertexLayout<Vertex>::get_attribute_descriptions();
+    auto instance_attribute_descriptions = VertexLayout<InstanceData>::get_attribute_descriptions(1);
+    std::vector<VkVertexInputAttributeDescription> attribute_descriptions(vertex_attribute_descriptions.begin(), vertex_attribute_descriptions.end());
+    attribute_descriptions.insert(attribute_descriptions.end(), instance_attribute_descriptions.begin(), instance_attribute_descriptions.end());
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info{};
     vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_info.vertexBindingDescriptionCount = 1;
-    vertex_input_info.pVertexBindingDescriptions = &binding_description;
+    vertex_input_info.vertexBindingDescriptionCount = sizeof(binding_descriptions)/sizeof(binding_descriptions[0]);
+    vertex_input_info.pVertexBindingDescriptions = binding_descriptions;
     vertex_input_info.vertexAttributeDescriptionCount = attribute_descriptions.size();
     vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
 
@@ -287,11 +480,19 @@ void VulkanRenderer::create_graphics_pipeline() {
     dynamic_state_info.dynamicStateCount = sizeof(enabled_dynamic_states) / sizeof(enabled_dynamic_states[0]);
     dynamic_state_info.pDynamicStates = enabled_dynamic_states;
     
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(DrawConstants);
+
+    VkDescriptorSetLayout set_layouts[] = {descriptor_set_layout, texture_table.get_descriptor_set_layout()};
+
     VkPipelineLayoutCreateInfo pipeline_layout_info{};
     pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_info.setLayoutCount = 1;
-    pipeline_layout_info.pSetLayouts = &descriptor_set_layout;
-    pipeline_layout_info.pushConstantRangeCount = 0;
+    pipeline_layout_info.setLayoutCount = sizeof(set_layouts)/sizeof(set_layouts[0]);
+    pipeline_layout_info.pSetLayouts = set_layouts;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constant_range;
 
     res = vkd.vkdf->vkCreatePipelineLayout(vkd.device, &pipeline_layout_info, nullptr, &pipeline_layout);
     if (res != VK_SUCCESS)
@@ -310,157 +511,398 @@ void VulkanRenderer::create_graphics_pipeline() {
     pipeline_info.pColorBlendState = &color_blending_info;
     pipeline_info.pDynamicState = &dynamic_state_info;
     pipeline_info.layout = pipeline_layout;
-    pipeline_info.renderPass = vulkan_window->get_default_render_pass();
+    pipeline_info.renderPass = render_target->get_default_render_pass();
     pipeline_info.subpass = 0;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.basePipelineIndex = -1;
 
-    res = vkd.vkdf->vkCreateGraphicsPipelines(vkd.device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &graphics_pipeline);
+    QElapsedTimer pipeline_timer;
+    pipeline_timer.start();
+    VkPipelineCache pipeline_cache = render_target->get_pipeline_cache()->get_vk_pipeline_cache();
+    res = vkd.vkdf->vkCreateGraphicsPipelines(vkd.device, pipeline_cache, 1, &pipeline_info, nullptr, &graphics_pipeline);
     if (res != VK_SUCCESS)
         qFatal("Failed to create graphics pipeline: %d", res);
+    pipeline_creation_time = pipeline_timer.nsecsElapsed();
+}
+
+void VulkanRenderer::create_culling_pipeline() {
+    VkPhysicalDeviceVulkan12Features vulkan12_features = render_target->get_enabled_vulkan12_features();
+    if (!vulkan12_features.drawIndirectCount || !enabled_device_features.multiDrawIndirect || !enabled_device_features.drawIndirectFirstInstance) {
+        qDebug() << "GPU culling unavailable: drawIndirectCount, multiDrawIndirect or drawIndirectFirstInstance not supported";
+        return;
+    }
+    vkCmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(
+        vkd.vkf->vkGetDeviceProcAddr(vkd.device, "vkCmdDrawIndexedIndirectCount")
+    );
+    if (vkCmdDrawIndexedIndirectCount == nullptr)
+        return;
+
+    ShaderModule compute_shader_module(vkd.device, vkd.vkdf, "src/shaders/cull.spv");
+    if (compute_shader_module.vk_shader_module == VK_NULL_HANDLE)
+        return;
+
+    // Bounds, draw commands & draw counts
+    VkDescriptorSetLayoutBinding bindings[3] = {};
+    for (uint32_t i=0; i<3; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = sizeof(bindings)/sizeof(bindings[0]);
+    layout_info.pBindings = bindings;
+
+    VkResult res = vkd.vkdf->vkCreateDescriptorSetLayout(vkd.device, &layout_info, nullptr, &culling_descriptor_set_layout);
+    if (res != VK_SUCCESS) {
+        qWarning("Failed to create culling descriptor set layout: %d", res);
+        return;
+    }
+
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(CullPushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &culling_descriptor_set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+    res = vkd.vkdf->vkCreatePipelineLayout(vkd.device, &pipeline_layout_info, nullptr, &culling_pipeline_layout);
+    if (res != VK_SUCCESS) {
+        qWarning("Failed to create culling pipeline layout: %d", res);
+        return;
+    }
+
+    VkComputePipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage = compute_shader_module.get_create_info(VK_SHADER_STAGE_COMPUTE_BIT);
+    pipeline_info.layout = culling_pipeline_layout;
+    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_info.basePipelineIndex = -1;
+
+    VkPipelineCache pipeline_cache = render_target->get_pipeline_cache()->get_vk_pipeline_cache();
+    res = vkd.vkdf->vkCreateComputePipelines(vkd.device, pipeline_cache, 1, &pipeline_info, nullptr, &culling_pipeline);
+    if (res != VK_SUCCESS) {
+        qWarning("Failed to create culling pipeline: %d", res);
+        culling_pipeline = VK_NULL_HANDLE;
+    }
+}
+
+void VulkanRenderer::load_mesh() {
+    if (mesh_path.isEmpty() || !mesh.load(mesh_path)) {
+        mesh.vertices = default_vertices;
+        mesh.indices = default_indices;
+    }
+
+    mesh_radius = 0.0f;
+    for (const Vertex& vertex : mesh.vertices)
+        mesh_radius = std::max(mesh_radius, glm::length(vertex.position));
+
+    QElapsedTimer optimize_timer;
+    optimize_timer.start();
+    MeshOptimizer::VertexCacheStats before = MeshOptimizer::analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+    MeshOptimizer::optimize_vertex_cache(mesh.indices, mesh.vertices.size());
+    MeshOptimizer::optimize_overdraw(mesh.indices, mesh.vertices);
+    MeshOptimizer::optimize_vertex_fetch(mesh.indices, mesh.vertices);
+    MeshOptimizer::VertexCacheStats after = MeshOptimizer::analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+    qint64 optimize_time = optimize_timer.nsecsElapsed();
+
+    qInfo() << "Mesh:" << mesh.vertices.size() << "vertices," << mesh.indices.size() / 3 << "triangles, optimized in" << optimize_time / 1000 << "us";
+    qInfo() << "  ACMR" << before.acmr << "->" << after.acmr << ", ATVR" << before.atvr << "->" << after.atvr
+            << ", vertex shader invocations" << before.vs_invocations << "->" << after.vs_invocations;
+    control_panel.update_mesh_stats(mesh.indices.size() / 3, before, after);
 }
 
 void VulkanRenderer::create_vertex_buffer() {
-    VkDeviceSize vertex_buffer_size = vertices.size() * sizeof(Vertex);
-    VkDeviceSize index_buffer_size = indices.size() * sizeof(Index);
+    const void* vertex_data = mesh.vertices.data();
+    VkDeviceSize vertex_buffer_size = mesh.vertices.size() * sizeof(Vertex);
+    VkDeviceSize index_buffer_size = mesh.indices.size() * sizeof(Index);
+
+    std::vector<PackedVertex> packed_vertices;
+    if (quantize_vertices) {
+        dequantization_matrix = VertexQuantizer::quantize(mesh.vertices, packed_vertices);
+        vertex_data = packed_vertices.data();
+        vertex_buffer_size = packed_vertices.size() * sizeof(PackedVertex);
+        qInfo() << "Vertices quantized:" << mesh.vertices.size() * sizeof(Vertex) << "->" << vertex_buffer_size << "bytes";
+    }
 
     vertex_buffer.create(vkd, Buffer::CreateData{vertex_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT});
     index_buffer.create(vkd, Buffer::CreateData{index_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT});
 
-    VkCommandBuffer command_buffer = begin_single_time_commands(vkd, vulkan_window->get_graphics_command_pool());
-    Buffer sb = vertex_buffer.copy_data_to_buffer(vertices.data(), vertex_buffer_size, command_buffer);
-    Buffer sb2 = index_buffer.copy_data_to_buffer(indices.data(), index_buffer_size, command_buffer);
-
-    // Make sure transfer has finished before the vertex & index buffers are used
-    VkMemoryBarrier memory_barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT};
-    vkd.vkdf->vkCmdPipelineBarrier(
-        command_buffer,
-        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-        0,
-        1, &memory_barrier,
-        0, nullptr,
-        0, nullptr
+    Uploader* uploader = render_target->get_uploader();
+    VkResult res = uploader->upload_to_buffer(
+        vertex_buffer.get_vk_buffer(), vertex_data, vertex_buffer_size, 0,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
     );
+    if (res != VK_SUCCESS)
+        qFatal("Failed to upload vertex buffer: %d", res);
 
-    end_single_time_commands(vkd, vulkan_window->get_graphics_command_pool(), vulkan_window->get_graphics_queue(), command_buffer, fence_timeout);
-    
-    // Clean up
-    sb.destroy();
-    sb2.destroy();
+    res = uploader->upload_to_buffer(
+        index_buffer.get_vk_buffer(), mesh.indices.data(), index_buffer_size, 0,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT
+    );
+    if (res != VK_SUCCESS)
+        qFatal("Failed to upload index buffer: %d", res);
 }
 
-void VulkanRenderer::create_texture_image() {
-    const QImage qt_image = QImage("textures/awesomeface.png").convertToFormat(QImage::Format_RGBA8888);
+void VulkanRenderer::create_transforms() {
+    transforms.clear();
+    spin_node = transforms.add_node(glm::mat4(1.0f));
+    mesh_node = transforms.add_node(dequantization_matrix, spin_node);
+    grid_node = transforms.add_node(glm::mat4(1.0f));
+}
 
-    Buffer staging_buffer{};
-    staging_buffer.create(vkd, Buffer::CreateData{(VkDeviceSize)qt_image.sizeInBytes(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT});
+void VulkanRenderer::create_instance_buffers() {
+    // Cubic grid filling roughly the same space as a single object
+    uint32_t grid_size = 1;
+    while (grid_size*grid_size*grid_size < nr_draws)
+        grid_size++;
+    float spacing = 2.0f / grid_size;
+    float scale = grid_size > 1 ? 0.5f * spacing : 1.0f;
+    instances.resize(nr_draws);
+    std::vector<glm::vec4> bounds(nr_draws);
+    frustum_culler.clear();
+    uint32_t first_instance_node = transforms.get_nr_nodes();
+    for (uint32_t i=0; i<nr_draws; i++) {
+        glm::vec3 cell(i % grid_size, (i / grid_size) % grid_size, i / (grid_size*grid_size));
+        glm::vec3 position = (cell - glm::vec3((grid_size - 1) * 0.5f)) * spacing;
+        transforms.add_node(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(scale)), grid_node);
+        instances[i].material_index = 0;
+        frustum_culler.add_sphere(position, scale * mesh_radius);
+        bounds[i] = glm::vec4(position, scale * mesh_radius);
+    }
+    transforms.update();
+    for (uint32_t i=0; i<nr_draws; i++)
+        instances[i].model = transforms.get_world(first_instance_node + i);
+
+    VkDrawIndexedIndirectCommand draw_command{};
+    draw_command.indexCount = mesh.indices.size();
+    draw_command.instanceCount = nr_draws;
+    draw_command.firstIndex = 0;
+    draw_command.vertexOffset = 0;
+    draw_command.firstInstance = 0;
+
+    VkDeviceSize instance_buffer_size = instances.size() * sizeof(InstanceData);
+    instance_buffer.create(vkd, Buffer::CreateData{instance_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT});
+    indirect_buffer.create(vkd, Buffer::CreateData{sizeof(draw_command), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT});
+
+    Uploader* uploader = render_target->get_uploader();
+    VkResult res = uploader->upload_to_buffer(
+        instance_buffer.get_vk_buffer(), instances.data(), instance_buffer_size, 0,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+    );
+    if (res != VK_SUCCESS)
+        qFatal("Failed to upload instance buffer: %d", res);
 
-    void* data;
-    vkd.vkdf->vkMapMemory(vkd.device, staging_buffer.get_vk_buffer_memory(), 0, qt_image.sizeInBytes(), 0, &data);
-    memcpy(data, qt_image.constBits(), qt_image.sizeInBytes());
-    vkd.vkdf->vkUnmapMemory(vkd.device, staging_buffer.get_vk_buffer_memory());
+    res = uploader->upload_to_buffer(
+        indirect_buffer.get_vk_buffer(), &draw_command, sizeof(draw_command), 0,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+    );
+    if (res != VK_SUCCESS)
+        qFatal("Failed to upload indirect draw buffer: %d", res);
+
+    // Sized for the most frames in flight, their number can change at runtime
+    uint32_t nr_concurrent_frames = render_target->get_max_concurrent_frames();
+    visible_instance_region_size = align_to(instance_buffer_size, 16);
+    // Written by the CPU every frame & read once by the GPU: resizable BAR memory if there is any
+    Buffer::CreateData visible_buffer_data{
+        visible_instance_region_size * nr_concurrent_frames, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+    };
+    visible_buffer_data.preferred_memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    visible_instance_buffer.create(vkd, visible_buffer_data);
+    visible_buffer_data.size = sizeof(VkDrawIndexedIndirectCommand) * nr_concurrent_frames;
+    visible_buffer_data.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    visible_indirect_buffer.create(vkd, visible_buffer_data);
+
+    if (culling_pipeline == VK_NULL_HANDLE)
+        return;
+
+    VkDeviceSize bounds_buffer_size = bounds.size() * sizeof(glm::vec4);
+    bounds_buffer.create(vkd, Buffer::CreateData{bounds_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT});
+    res = uploader->upload_to_buffer(
+        bounds_buffer.get_vk_buffer(), bounds.data(), bounds_buffer_size, 0,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+    );
+    if (res != VK_SUCCESS)
+        qFatal("Failed to upload bounds buffer: %d", res);
+
+    gpu_draw_command_buffer.create(vkd, Buffer::CreateData{
+        VkDeviceSize(nr_draws) * sizeof(VkDrawIndexedIndirectCommand) * nr_concurrent_frames,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    });
+    // Read back by the CPU, which is much faster from cached memory
+    Buffer::CreateData count_buffer_data{
+        sizeof(uint32_t) * nr_concurrent_frames,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+    };
+    count_buffer_data.preferred_memory_properties = VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    gpu_draw_count_buffer.create(vkd, count_buffer_data);
+    // Read back before the first culling pass of each frame
+    memset(gpu_draw_count_buffer.get_mapped_memory(), 0, sizeof(uint32_t) * nr_concurrent_frames);
+    gpu_draw_count_buffer.flush();
+}
 
-    Image::CreateData icd = Image::CreateData::default_texture_data(qt_image.width(), qt_image.height());
-    icd.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    texture_image.create(vkd, icd);
+void VulkanRenderer::cull_instances(uint32_t current_frame_index) {
+    QElapsedTimer cull_timer;
+    cull_timer.start();
 
-    VkCommandPool command_pool = vulkan_window->get_graphics_command_pool();
-    VkCommandBuffer command_buffer = begin_single_time_commands(vkd, command_pool);
+    frustum_culler.cull(frustum, visible_instances);
 
-    texture_image.transition_image_layout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, command_buffer);
-    texture_image.copy_buffer_to_image(staging_buffer.get_vk_buffer(), command_buffer);
-    texture_image.transition_image_layout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, command_buffer);
+    InstanceData* instance_data = reinterpret_cast<InstanceData*>(
+        static_cast<uchar*>(visible_instance_buffer.get_mapped_memory()) + current_frame_index * visible_instance_region_size
+    );
+    for (size_t i=0; i<visible_instances.size(); i++)
+        instance_data[i] = instances[visible_instances[i]];
 
-    VkQueue queue = vulkan_window->get_graphics_queue();
-    end_single_time_commands(vkd, command_pool, queue, command_buffer, fence_timeout);
+    VkDrawIndexedIndirectCommand* draw_command = static_cast<VkDrawIndexedIndirectCommand*>(visible_indirect_buffer.get_mapped_memory()) + current_frame_index;
+    draw_command->indexCount = mesh.indices.size();
+    draw_command->instanceCount = visible_instances.size();
+    draw_command->firstIndex = 0;
+    draw_command->vertexOffset = 0;
+    draw_command->firstInstance = 0;
 
-    texture_image.create_view();
-    VkSamplerCreateInfo sci = Image::default_texture_sampler_create_info(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, enabled_device_features.samplerAnisotropy);
-    sci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    texture_image.create_sampler(sci);
+    visible_instance_buffer.flush(current_frame_index * visible_instance_region_size, visible_instances.size() * sizeof(InstanceData));
+    visible_indirect_buffer.flush(current_frame_index * sizeof(VkDrawIndexedIndirectCommand), sizeof(VkDrawIndexedIndirectCommand));
 
-    staging_buffer.destroy();
+    control_panel.update_culling_stats(visible_instances.size(), nr_draws, cull_timer.nsecsElapsed());
 }
 
-void VulkanRenderer::create_descriptor_pool() {
-    VkDescriptorPoolSize pool_sizes[] = {
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
-        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
+void VulkanRenderer::create_culling_descriptor_set() {
+    if (culling_pipeline == VK_NULL_HANDLE)
+        return;
+
+    // Whole buffers, the frame's regions are selected with push constants
+    std::vector<DescriptorCache::Binding> bindings = {
+        DescriptorCache::Binding::buffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bounds_buffer.get_vk_buffer(), 0, VK_WHOLE_SIZE),
+        DescriptorCache::Binding::buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, gpu_draw_command_buffer.get_vk_buffer(), 0, VK_WHOLE_SIZE),
+        DescriptorCache::Binding::buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, gpu_draw_count_buffer.get_vk_buffer(), 0, VK_WHOLE_SIZE),
     };
+    VkResult res = render_target->get_descriptor_cache()->get(culling_descriptor_set_layout, bindings, culling_descriptor_set);
+    if (res != VK_SUCCESS)
+        qFatal("Failed to get culling descriptor set: %d", res);
+}
 
-    VkDescriptorPoolCreateInfo pool_create_info{};
-    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    pool_create_info.poolSizeCount = sizeof(pool_sizes)/sizeof(pool_sizes[0]);
-    pool_create_info.pPoolSizes = pool_sizes;
-    pool_create_info.maxSets = 1;
+void VulkanRenderer::record_gpu_culling(VkCommandBuffer command_buffer, uint32_t current_frame_index) {
+    QElapsedTimer cull_timer;
+    cull_timer.start();
 
+    // The frame that last used this frame index has finished, so its count is the latest available
+    gpu_draw_count_buffer.invalidate(current_frame_index * sizeof(uint32_t), sizeof(uint32_t));
+    uint32_t nr_visible = static_cast<uint32_t*>(gpu_draw_count_buffer.get_mapped_memory())[current_frame_index];
 
-    VkResult res = vkd.vkdf->vkCreateDescriptorPool(vkd.device, &pool_create_info, nullptr, &descriptor_pool);
-    if (res != VK_SUCCESS)
-        qFatal("Failed to create descriptor pool: %d", res);
-}
+    FrameProfiler* frame_profiler = render_target->get_frame_profiler();
+    uint32_t culling_scope = frame_profiler->begin_scope(command_buffer, "GPU culling");
+
+    vkd.vkdf->vkCmdFillBuffer(command_buffer, gpu_draw_count_buffer.get_vk_buffer(), current_frame_index * sizeof(uint32_t), sizeof(uint32_t), 0);
+
+    VkMemoryBarrier clear_barrier{};
+    clear_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clear_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clear_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkd.vkdf->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        1, &clear_barrier, 0, nullptr, 0, nullptr
+    );
 
-void VulkanRenderer::create_uniform_buffers() {
-    VkDeviceSize ubo_size = sizeof(UniformBufferObject);
-    VkPhysicalDeviceProperties pdp;
-    vkd.vkf->vkGetPhysicalDeviceProperties(vkd.physical_device, &pdp);
-    aligned_size = align_to(ubo_size, pdp.limits.minUniformBufferOffsetAlignment);
+    CullPushConstants push_constants{};
+    std::copy(std::begin(frustum.planes), std::end(frustum.planes), push_constants.planes);
+    push_constants.nr_objects = nr_draws;
+    push_constants.index_count = mesh.indices.size();
+    push_constants.first_command = current_frame_index * nr_draws;
+    push_constants.count_index = current_frame_index;
+
+    vkd.vkdf->vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling_pipeline);
+    vkd.vkdf->vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling_pipeline_layout, 0, 1, &culling_descriptor_set, 0, nullptr);
+    vkd.vkdf->vkCmdPushConstants(command_buffer, culling_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+    vkd.vkdf->vkCmdDispatch(command_buffer, (nr_draws + culling_workgroup_size - 1) / culling_workgroup_size, 1, 1);
+
+    // The draw reads the commands & count, the host reads the count once the frame has finished
+    VkMemoryBarrier cull_barrier{};
+    cull_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cull_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cull_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkd.vkdf->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0,
+        1, &cull_barrier, 0, nullptr, 0, nullptr
+    );
 
-    VkDeviceSize buffer_size = aligned_size * vulkan_window->get_nr_concurrent_frames();
+    frame_profiler->end_scope(command_buffer, culling_scope);
 
-    uniform_buffer.create(vkd, Buffer::CreateData{buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT});
+    control_panel.update_culling_stats(nr_visible, nr_draws, cull_timer.nsecsElapsed());
+}
 
-    vkd.vkdf->vkMapMemory(vkd.device, uniform_buffer.get_vk_buffer_memory(), 0, buffer_size, 0, reinterpret_cast<void**>(&uniform_buffer_memory_ptr));
+void VulkanRenderer::request_texture() {
+    // Pre-baked block-compressed textures (with all mip levels) in order of preference, the PNG is the fallback
+    QStringList paths;
+    paths << "textures/awesomeface.bc7.ktx2" << "textures/awesomeface.astc.ktx2" << "textures/awesomeface.etc2.ktx2"
+          << "textures/awesomeface.png";
+    texture = render_target->get_texture_streamer()->request(paths);
 }
 
-void VulkanRenderer::create_descriptor_sets() {
-    VkDescriptorSetAllocateInfo allocation_info{};
-    allocation_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocation_info.descriptorPool = descriptor_pool;
-    allocation_info.descriptorSetCount = 1;
-    allocation_info.pSetLayouts = &descriptor_set_layout;
+void VulkanRenderer::create_texture_table() {
+    // Without descriptor indexing every object is drawn with the last texture added to the table
+    QString missing_features = TextureTable::get_missing_features(render_target->get_enabled_vulkan12_features());
+    bool single_texture = !missing_features.isEmpty();
+    if (single_texture)
+        qWarning("Descriptor indexing isn't supported (missing %s), falling back to a single texture", qPrintable(missing_features));
 
-    VkResult res = vkd.vkdf->vkAllocateDescriptorSets(vkd.device, &allocation_info, &descriptor_set);
+    VkResult res = texture_table.create(vkd, 4096, VK_SHADER_STAGE_FRAGMENT_BIT, single_texture);
     if (res != VK_SUCCESS)
-        qFatal("Failed to alocate descriptor set: %d", res);
-
-    VkDescriptorBufferInfo buffer_info{};
-    buffer_info.buffer = uniform_buffer.get_vk_buffer();
-    buffer_info.offset = 0;
-    buffer_info.range = sizeof(UniformBufferObject);
-
-    VkDescriptorImageInfo image_info{};
-    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    image_info.imageView = texture_image.get_vk_image_view();
-    image_info.sampler = texture_image.get_vk_sampler();
-
-    VkWriteDescriptorSet descriptor_writes[2] = {};
-
-    descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptor_writes[0].dstSet = descriptor_set;
-    descriptor_writes[0].dstBinding = 0;
-    descriptor_writes[0].dstArrayElement = 0;
-    descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    descriptor_writes[0].descriptorCount = 1;
-    descriptor_writes[0].pBufferInfo = &buffer_info;
-
-    descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptor_writes[1].dstSet = descriptor_set;
-    descriptor_writes[1].dstBinding = 1;
-    descriptor_writes[1].dstArrayElement = 0;
-    descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptor_writes[1].descriptorCount = 1;
-    descriptor_writes[1].pImageInfo = &image_info;
-
-    vkd.vkdf->vkUpdateDescriptorSets(vkd.device, sizeof(descriptor_writes)/sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
+        qFatal("Failed to create texture table: %d", res);
+
+    Image& placeholder = render_target->get_texture_streamer()->get_placeholder();
+    placeholder_slot = texture_table.add(placeholder.get_vk_image_view(), placeholder.get_vk_sampler());
+    if (placeholder_slot == TextureTable::invalid_slot)
+        qFatal("Failed to add the placeholder texture to the texture table");
+    texture_slot = placeholder_slot;
+    std::fill(std::begin(ubo.material_texture_slots), std::end(ubo.material_texture_slots), placeholder_slot);
 }
 
-void VulkanRenderer::update_uniform_buffer(uint32_t current_frame_index) {
+void VulkanRenderer::create_descriptor_sets() {
+    // The chunk of the frame's UBO is selected with a dynamic offset
+    std::vector<DescriptorCache::Binding> bindings = {
+        DescriptorCache::Binding::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, render_target->get_uniform_allocator()->get_vk_buffer(), 0, sizeof(UniformBufferObject)),
+    };
+    VkResult res = render_target->get_descriptor_cache()->get(descriptor_set_layout, bindings, descriptor_set);
+    if (res != VK_SUCCESS)
+        qFatal("Failed to get descriptor set: %d", res);
+}
+
+void VulkanRenderer::update_uniform_buffer() {
     static float angle = 0.0f;
     angle += 0.025f;
-    ubo.model = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f,1.0f,0.0f));
-    ubo.view = glm::lookAt(glm::vec3(2.0f,2.0f,2.0f), glm::vec3(0.0f,0.0f,0.0f), glm::vec3(0.0f,1.0f,0.0f));
-    ubo.projection = glm::perspective(glm::radians(45.0f), vulkan_window->width()/float(vulkan_window->height()), 0.1f, 10.0f);
-
-    memcpy(uniform_buffer_memory_ptr + current_frame_index*aligned_size, &ubo, sizeof(ubo));
+    transforms.set_local(spin_node, glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f,1.0f,0.0f)));
+    transforms.update();
+    draw_constants.model = transforms.get_world(mesh_node);
+    // Every object uses material 0
+    ubo.material_texture_slots[0] = texture_slot;
+
+    bool view_projection_changed = view_dirty;
+    if (view_dirty) {
+        view = glm::lookAt(camera_position, camera_target, glm::vec3(0.0f,1.0f,0.0f));
+        view_dirty = false;
+    }
+    VkExtent2D extent = render_target->get_image_extent();
+    if (extent.width != projection_extent.width || extent.height != projection_extent.height) {
+        projection = glm::perspective(glm::radians(45.0f), extent.width/float(extent.height), 0.1f, 10.0f);
+        projection_extent = extent;
+        view_projection_changed = true;
+    }
+    // Multiplied once here instead of for every vertex
+    if (view_projection_changed) {
+        ubo.view_projection = projection * view;
+        frustum = FrustumCuller::extract_frustum(ubo.view_projection);
+    }
+
+    UniformAllocator::Chunk chunk = render_target->get_uniform_allocator()->upload(ubo);
+    if (chunk.data == nullptr)
+        qFatal("Failed to allocate uniform buffer chunk");
+    ubo_offset = chunk.offset;
 }
\ No newline at end of file
@@ -9,16 +9,31 @@
 #include <QElapsedTimer>
 
 #include "VulkanFunctions.hpp"
-#include "VulkanWindow.hpp"
+#include "VulkanRenderTarget.hpp"
 #include "Image.hpp"
 #include "Buffer.hpp"
+#include "Mesh.hpp"
+#include "FrustumCuller.hpp"
+#include "TransformHierarchy.hpp"
+#include "TextureTable.hpp"
 
 #include "settings/ControlPanel.hpp"
 
+// Matches `max_materials` in color.vert.glsl
+const uint32_t max_materials = 1024;
+
+// Per frame
 struct UniformBufferObject {
+    // Only recomputed when the camera or image extent changes
+    glm::mat4 view_projection;
+    // TextureTable slot of every material's texture (read as uvec4s with std140)
+    uint32_t material_texture_slots[max_materials];
+};
+
+// Per draw, pushed before the draws of every command buffer (push constants aren't inherited by secondary command buffers)
+// Must fit in the guaranteed 128 bytes of push constants, larger per-object data goes in the instance buffer
+struct DrawConstants {
     glm::mat4 model;
-    glm::mat4 view;
-    glm::mat4 projection;
 };
 
 class VulkanRenderer : public AbstractVulkanRenderer {
@@ -26,7 +41,7 @@ public:
     VulkanRenderer();
     ~VulkanRenderer() override;
 
-    void pre_init_resources(VulkanWindow* vulkan_window) override;
+    void pre_init_resources(VulkanRenderTarget* render_target) override;
     void init_resources() override;
     void init_swap_chain_resources() override;
     void release_swap_chain_resources() override;
@@ -34,8 +49,36 @@ public:
 
     void start_next_frame() override;
 
+    // Draws are recorded inline with one thread and split over secondary command buffers otherwise
+    // `nr_threads` is clamped to the render target's maximum number of recording threads
+    void set_recording_threads(uint32_t nr_threads);
+    enum class DrawMode {
+        Direct,   // One vkCmdDrawIndexed per object, split over the recording threads
+        Indirect, // All objects in one instanced vkCmdDrawIndexedIndirect from a GPU-resident command buffer
+    };
+    void set_draw_mode(DrawMode draw_mode) {this->draw_mode = draw_mode; reset_record_stats();}
+    enum class CullingMode {
+        None, // All objects are drawn from the GPU-resident instance buffer
+        Cpu,  // Objects outside the view frustum are culled with FrustumCuller & the visible ones' instance data is written every frame
+        Gpu,  // A compute pass writes one draw command per visible object, drawn with vkCmdDrawIndexedIndirectCount regardless of the draw mode
+    };
+    // Gpu falls back to Cpu if the device doesn't support it (only known from `init_resources` on)
+    void set_culling_mode(CullingMode culling_mode);
+    // Number of objects (instances of the model) drawn per frame. Must be set before `init_resources`
+    void set_nr_draws(uint32_t nr_draws) {this->nr_draws = std::max(nr_draws, 1u);}
+    // OBJ or glTF file drawn instead of the built-in quads. Must be set before `init_resources`
+    void set_mesh_path(const QString& mesh_path) {this->mesh_path = mesh_path;}
+    // Vertices are packed into `PackedVertex` (half the size of `Vertex`) unless disabled. Must be set before `init_resources`
+    void set_quantize_vertices(bool quantize_vertices) {this->quantize_vertices = quantize_vertices;}
+    // The view is only recomputed after the camera moved
+    void set_camera(glm::vec3 position, glm::vec3 target) {camera_position = position; camera_target = target; view_dirty = true;}
+
+    // Average CPU time (ns) spent recording the draws since the last `reset_record_stats`
+    qint64 get_average_record_time() {return nr_recorded_frames != 0 ? total_record_time / nr_recorded_frames : 0;}
+    void reset_record_stats() {total_record_time = 0; nr_recorded_frames = 0;}
+
 private:
-    VulkanWindow* vulkan_window = nullptr;
+    VulkanRenderTarget* render_target = nullptr;
 
     VulkanData vkd{};
     VkPhysicalDeviceFeatures enabled_device_features{};
@@ -47,33 +90,114 @@ private:
     VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
     VkPipeline graphics_pipeline = VK_NULL_HANDLE;
 
+    // Leaves `culling_pipeline` null if GPU culling isn't supported (see `set_culling_mode`)
+    void create_culling_pipeline();
+    VkDescriptorSetLayout culling_descriptor_set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout culling_pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline culling_pipeline = VK_NULL_HANDLE;
+    // Vulkan 1.2 core, not part of QVulkanDeviceFunctions
+    PFN_vkCmdDrawIndexedIndirectCount vkCmdDrawIndexedIndirectCount = nullptr;
+
+    // Loads & optimizes the mesh (falling back to the built-in quads), reporting the vertex cache stats before & after
+    void load_mesh();
+    QString mesh_path;
+    Mesh mesh;
+    // Radius of the mesh's bounding sphere around its origin (which the model matrix rotates around)
+    float mesh_radius = 0.0f;
+
     // Creates both vertex and index buffers
     void create_vertex_buffer();
+    bool quantize_vertices = true;
+    // Transforms the quantized positions back into the mesh's space (identity without quantization)
+    glm::mat4 dequantization_matrix = glm::mat4(1.0f);
     Buffer vertex_buffer{};
     Buffer index_buffer{};
 
-    void create_texture_image();
-    Image texture_image{};
-    
-    void create_descriptor_pool();
-    VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
-
-    void create_uniform_buffers();
-    Buffer uniform_buffer{};
-    VkDeviceSize aligned_size = 0;
-    uchar* uniform_buffer_memory_ptr = nullptr;
-
+    // The spinning model node with the mesh (dequantization) as its child & the root of the object grid
+    void create_transforms();
+    TransformHierarchy transforms;
+    uint32_t spin_node = 0;
+    uint32_t mesh_node = 0;
+    uint32_t grid_node = 0;
+
+    // Places the `nr_draws` objects in a grid (as children of `grid_node`) & creates the indirect draw command drawing all of them
+    // Also creates the per-frame buffers the visible objects are written to with culling
+    void create_instance_buffers();
+    std::vector<InstanceData> instances;
+    Buffer instance_buffer{};
+    Buffer indirect_buffer{};
+
+    // Culls the objects against the current view & writes the visible objects' instance data & indirect draw for `current_frame_index`
+    void cull_instances(uint32_t current_frame_index);
+    CullingMode culling_mode = CullingMode::Cpu;
+    FrustumCuller frustum_culler;
+    std::vector<uint32_t> visible_instances;
+    // One region per concurrent frame, persistently mapped
+    Buffer visible_instance_buffer{};
+    Buffer visible_indirect_buffer{};
+    VkDeviceSize visible_instance_region_size = 0;
+
+    // Records the culling pass writing `current_frame_index`'s draw commands & count, before the render pass
+    void record_gpu_culling(VkCommandBuffer command_buffer, uint32_t current_frame_index);
+    // From the render target's descriptor cache
+    void create_culling_descriptor_set();
+    VkDescriptorSet culling_descriptor_set = VK_NULL_HANDLE;
+    // Bounding sphere of every object (xyz: center, w: radius)
+    Buffer bounds_buffer{};
+    // `nr_draws` commands & one count per concurrent frame. The count buffer is host visible so the number of
+    // visible objects can be read back once the frame has finished
+    Buffer gpu_draw_command_buffer{};
+    Buffer gpu_draw_count_buffer{};
+
+    // Loaded in the background, the placeholder is used until it is resident
+    void request_texture();
+    TextureStreamer::Handle texture = 0;
+
+    // All textures, bound once as set 1. Materials refer to them by slot through `ubo.material_texture_slots`
+    void create_texture_table();
+    TextureTable texture_table{};
+    uint32_t placeholder_slot = 0;
+    // `placeholder_slot` until the streamed texture is resident
+    uint32_t texture_slot = 0;
+
+    // Uploader value of the vertex & index uploads (the texture placeholder was uploaded before). Nothing is drawn until they are ready
+    uint64_t upload_value = 0;
+
+    // From the render target's descriptor cache
     void create_descriptor_sets();
     VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
 
-    void update_uniform_buffer(uint32_t current_frame_index);
+    // Only dirty transforms are recomputed, the view & projection only when the camera or image extent changed
+    // `ubo` is copied to a new chunk of the render target's uniform allocator every frame
+    void update_uniform_buffer();
     UniformBufferObject ubo{};
+    // Dynamic offset of this frame's copy of `ubo`
+    uint32_t ubo_offset = 0;
+    DrawConstants draw_constants{};
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 camera_position = glm::vec3(2.0f, 2.0f, 2.0f);
+    glm::vec3 camera_target = glm::vec3(0.0f, 0.0f, 0.0f);
+    bool view_dirty = true;
+    VkExtent2D projection_extent{};
+    // Of `ubo.view_projection`, used by both culling modes
+    FrustumCuller::Frustum frustum{};
+
+    // Records the draws of objects [`first_draw`, `first_draw`+`draw_count`) including all the state they need
+    void record_draws(VkCommandBuffer command_buffer, uint32_t first_draw, uint32_t draw_count, uint32_t current_frame_index);
+    DrawMode draw_mode = DrawMode::Indirect;
+    uint32_t nr_recording_threads = 1;
+    uint32_t nr_draws = 1;
+    qint64 total_record_time = 0; // ns
+    uint64_t nr_recorded_frames = 0;
 
 
     // One second fence timeout
     const uint64_t fence_timeout = 1'000'000'000;
 
     QElapsedTimer fps_timer;
+    QElapsedTimer startup_timer; // From `pre_init_resources` to the end of `init_resources`
+    qint64 pipeline_creation_time = 0; // ns
     ControlPanel control_panel;
 };
 
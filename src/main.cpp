@@ -1,12 +1,150 @@
 #include <QApplication>
 #include <QVulkanInstance>
 #include <QLoggingCategory>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
 
 #include "VulkanWindow.hpp"
+#include "HeadlessRenderTarget.hpp"
 #include "VulkanRenderer.hpp"
+#include "FrustumCuller.hpp"
+
+// Renders `nr_frames` frames offscreen and reports the average frame time
+int run_headless(QVulkanInstance* inst, uint32_t nr_frames, bool use_pipeline_cache, const QString& mesh_path, bool quantize_vertices,
+                 VulkanRenderer::CullingMode culling_mode) {
+    VulkanRenderer* vulkan_renderer = new VulkanRenderer();
+    vulkan_renderer->set_mesh_path(mesh_path);
+    vulkan_renderer->set_quantize_vertices(quantize_vertices);
+    vulkan_renderer->set_culling_mode(culling_mode);
+    HeadlessRenderTarget render_target(vulkan_renderer, inst, VkExtent2D{800, 600});
+    if (!use_pipeline_cache)
+        render_target.set_pipeline_cache_path(QString());
+    render_target.start();
+
+    QElapsedTimer timer;
+    timer.start();
+    uint32_t nr_rendered_frames = render_target.render_frames(nr_frames);
+    qint64 elapsed = timer.nsecsElapsed();
+    // Not part of the frame time (waits for the device, saves the pipeline cache & destroys every resource)
+    render_target.stop();
+
+    qInfo() << "Headless:" << nr_rendered_frames << "frames in" << elapsed / 1'000'000 << "ms," <<
+               (nr_rendered_frames != 0 ? elapsed / nr_rendered_frames / 1000 : 0) << "us per frame";
+    return 0;
+}
+
+// Records `nr_draws` draws per frame offscreen with 1, 2, 4, ... threads and reports how recording throughput scales,
+// then compares with a single indirect draw of all objects
+int run_record_benchmark(QVulkanInstance* inst, uint32_t nr_draws, const QString& mesh_path, bool quantize_vertices) {
+    VulkanRenderer* vulkan_renderer = new VulkanRenderer();
+    vulkan_renderer->set_nr_draws(nr_draws);
+    vulkan_renderer->set_draw_mode(VulkanRenderer::DrawMode::Direct);
+    // Every object is recorded, not only the ones in the view frustum
+    vulkan_renderer->set_culling_mode(VulkanRenderer::CullingMode::None);
+    vulkan_renderer->set_mesh_path(mesh_path);
+    vulkan_renderer->set_quantize_vertices(quantize_vertices);
+    HeadlessRenderTarget render_target(vulkan_renderer, inst, VkExtent2D{800, 600});
+    render_target.start();
+
+    const uint32_t nr_warmup_frames = 20;
+    const uint32_t nr_measured_frames = 200;
+    uint32_t max_threads = render_target.get_max_recording_threads();
+    qint64 single_thread_time = 0;
+    for (uint32_t nr_threads=1; ; nr_threads=std::min(nr_threads*2, max_threads)) {
+        vulkan_renderer->set_recording_threads(nr_threads);
+        render_target.render_frames(nr_warmup_frames);
+        vulkan_renderer->reset_record_stats();
+        render_target.render_frames(nr_measured_frames);
+
+        qint64 record_time = vulkan_renderer->get_average_record_time();
+        if (nr_threads == 1)
+            single_thread_time = record_time;
+        qInfo() << "Recording" << nr_draws << "draws with" << nr_threads << "threads:" << record_time / 1000 << "us," <<
+                   (record_time != 0 ? nr_draws * 1'000'000.0 / record_time : 0.0) << "draws/ms, speedup" <<
+                   (record_time != 0 ? double(single_thread_time) / record_time : 0.0);
+
+        if (nr_threads == max_threads)
+            break;
+    }
 
+    vulkan_renderer->set_draw_mode(VulkanRenderer::DrawMode::Indirect);
+    render_target.render_frames(nr_warmup_frames);
+    vulkan_renderer->reset_record_stats();
+    render_target.render_frames(nr_measured_frames);
+    qint64 indirect_record_time = vulkan_renderer->get_average_record_time();
+    qInfo() << "Recording" << nr_draws << "instances with one indirect draw:" << indirect_record_time / 1000.0 << "us, speedup" <<
+               (indirect_record_time != 0 ? double(single_thread_time) / indirect_record_time : 0.0);
+    render_target.stop();
+    return 0;
+}
+
+// Culls `nr_objects` random bounding spheres with every path the CPU supports & reports the objects culled per ms
+int run_cull_benchmark(uint32_t nr_objects) {
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+    FrustumCuller culler;
+    for (uint32_t i=0; i<nr_objects; i++)
+        culler.add_sphere(glm::vec3(position(rng), position(rng), position(rng)), radius(rng));
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f,0.0f,0.0f), glm::vec3(0.0f,1.0f,0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f/9.0f, 0.1f, 100.0f);
+    FrustumCuller::Frustum frustum = FrustumCuller::extract_frustum(projection * view);
+
+    const uint32_t nr_iterations = 100;
+    std::vector<uint32_t> visible;
+    std::pair<FrustumCuller::Path, const char*> paths[] = {
+        {FrustumCuller::Path::Scalar, "scalar"}, {FrustumCuller::Path::SSE, "SSE"}, {FrustumCuller::Path::AVX2, "AVX2"},
+    };
+    for (const auto& path : paths) {
+        if (!FrustumCuller::is_path_supported(path.first)) {
+            qInfo() << "Culling with" << path.second << "is not supported";
+            continue;
+        }
+        culler.set_path(path.first);
+        culler.cull(frustum, visible);
+
+        QElapsedTimer timer;
+        timer.start();
+        for (uint32_t i=0; i<nr_iterations; i++)
+            culler.cull(frustum, visible);
+        qint64 cull_time = timer.nsecsElapsed() / nr_iterations;
+
+        qInfo() << "Culling" << nr_objects << "objects with" << path.second << ":" << cull_time / 1000.0 << "us," <<
+                   (cull_time != 0 ? nr_objects * 1'000'000.0 / cull_time : 0.0) << "objects/ms," << visible.size() << "visible";
+    }
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
+    // Usage: vulkan_test [--no-pipeline-cache] [--no-quantize] [--gpu-culling] [--mesh path] [--headless [nr_frames] | --record-benchmark [nr_draws] | --cull-benchmark [nr_objects]]
+    uint32_t nr_headless_frames = 0;
+    uint32_t nr_benchmark_draws = 0;
+    uint32_t nr_cull_benchmark_objects = 0;
+    QString mesh_path;
+    for (int i=1; i<argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0)
+            nr_headless_frames = (i+1 < argc && atoi(argv[i+1]) > 0) ? atoi(argv[i+1]) : 1000;
+        if (strcmp(argv[i], "--record-benchmark") == 0)
+            nr_benchmark_draws = (i+1 < argc && atoi(argv[i+1]) > 0) ? atoi(argv[i+1]) : 20000;
+        if (strcmp(argv[i], "--cull-benchmark") == 0)
+            nr_cull_benchmark_objects = (i+1 < argc && atoi(argv[i+1]) > 0) ? atoi(argv[i+1]) : 1'000'000;
+        if (strcmp(argv[i], "--mesh") == 0 && i+1 < argc)
+            mesh_path = QString::fromLocal8Bit(argv[i+1]);
+    }
+    // Doesn't need Vulkan (or Qt) at all
+    if (nr_cull_benchmark_objects != 0)
+        return run_cull_benchmark(nr_cull_benchmark_objects);
+
+    // No display is needed for the control panel either
+    if ((nr_headless_frames != 0 || nr_benchmark_draws != 0) && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
     QApplication app(argc, argv);
 
     QLoggingCategory::setFilterRules(QStringLiteral("qt.vulkan=true"));
@@ -18,9 +156,25 @@ int main(int argc, char *argv[]) {
     if (!inst.create())
         qFatal("Failed to create Vulkan instance: %d", inst.errorCode());
 
+    // Allows measuring cold startup times
+    bool use_pipeline_cache = !app.arguments().contains("--no-pipeline-cache");
+    // Allows comparing against full precision vertices
+    bool quantize_vertices = !app.arguments().contains("--no-quantize");
+    VulkanRenderer::CullingMode culling_mode = app.arguments().contains("--gpu-culling") ? VulkanRenderer::CullingMode::Gpu : VulkanRenderer::CullingMode::Cpu;
+
+    if (nr_benchmark_draws != 0)
+        return run_record_benchmark(&inst, nr_benchmark_draws, mesh_path, quantize_vertices);
+    if (nr_headless_frames != 0)
+        return run_headless(&inst, nr_headless_frames, use_pipeline_cache, mesh_path, quantize_vertices, culling_mode);
+
     VulkanRenderer* vulkan_renderer = new VulkanRenderer();
+    vulkan_renderer->set_mesh_path(mesh_path);
+    vulkan_renderer->set_quantize_vertices(quantize_vertices);
+    vulkan_renderer->set_culling_mode(culling_mode);
     VulkanWindow vulkan_window(vulkan_renderer);
     vulkan_window.setVulkanInstance(&inst);
+    if (!use_pipeline_cache)
+        vulkan_window.set_pipeline_cache_path(QString());
     vulkan_window.resize(800,600);
     vulkan_window.show();
 
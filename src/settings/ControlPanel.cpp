@@ -1,20 +1,167 @@
 #include "ControlPanel.hpp"
 
+#include <QStringList>
+#include <QSignalBlocker>
+
 #include <numeric>
 
+namespace {
+    const char* present_mode_name(VkPresentModeKHR present_mode) {
+        switch (present_mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            return "Immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return "Mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR:
+            return "FIFO";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return "FIFO Relaxed";
+        default:
+            return "Unknown";
+        }
+    }
+}
+
 ControlPanel::ControlPanel(QWidget* parent) : QWidget(parent) {
     layout = new QGridLayout(this);
     layout->addWidget(&frame_time_label, 0, 0);
     layout->addWidget(&average_frame_time_label, 1, 0);
+    layout->addWidget(&memory_allocations_label, 2, 0);
+    layout->addWidget(&memory_usage_label, 3, 0);
+    layout->addWidget(&memory_fragmentation_label, 4, 0);
+    layout->addWidget(&startup_time_label, 5, 0);
+    layout->addWidget(&cpu_record_time_label, 6, 0);
+    layout->addWidget(&fence_wait_time_label, 7, 0);
+    layout->addWidget(&gpu_time_label, 8, 0);
+    layout->addWidget(&gpu_scopes_label, 9, 0);
+    layout->addWidget(&mesh_stats_label, 10, 0);
+    layout->addWidget(&culling_stats_label, 11, 0);
+    layout->addWidget(&swap_chain_stats_label, 12, 0);
+
+    frames_in_flight_title.setText("Frames in Flight");
+    frames_in_flight_box.setRange(1, VulkanRenderTarget::get_max_concurrent_frames());
+    layout->addWidget(&frames_in_flight_title, 13, 0);
+    layout->addWidget(&frames_in_flight_box, 13, 1);
+
+    present_mode_title.setText("Present Mode");
+    for (VkPresentModeKHR present_mode : {VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR})
+        present_mode_box.addItem(present_mode_name(present_mode), int(present_mode));
+    layout->addWidget(&present_mode_title, 14, 0);
+    layout->addWidget(&present_mode_box, 14, 1);
+
+    image_count_title.setText("Swapchain Images");
+    image_count_box.setRange(2, 8);
+    layout->addWidget(&image_count_title, 15, 0);
+    layout->addWidget(&image_count_box, 15, 1);
+
+    layout->addWidget(&pacing_stats_label, 16, 0, 1, 2);
+
+    connect(&frames_in_flight_box, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int value) {
+        emit nr_frames_in_flight_changed(value);
+    });
+    connect(&present_mode_box, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int) {
+        emit present_mode_changed(VkPresentModeKHR(present_mode_box.currentData().toInt()));
+    });
+    connect(&image_count_box, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int value) {
+        emit image_count_changed(value);
+    });
 }
 
-void ControlPanel::update_frame_time(int ms) {
-    frame_time_label.setText("Frame Time: " + QString::number(ms));
+void ControlPanel::update_frame_time(qint64 frame_time) {
+    frame_time_label.setText("Frame Time: " + QString::number(frame_time / 1e6, 'f', 3) + " ms");
 
-    frame_times[current_frame_time_index] = ms;
+    frame_times[current_frame_time_index] = frame_time;
     int frame_time_array_size = sizeof(frame_times)/sizeof(frame_times[0]);
     current_frame_time_index = (current_frame_time_index+1) % (frame_time_array_size);
-    float average_frame_time = std::accumulate(frame_times, frame_times+frame_time_array_size, 0) / float(frame_time_array_size);
+    double average_frame_time = std::accumulate(frame_times, frame_times+frame_time_array_size, qint64(0)) / double(frame_time_array_size);
+
+    average_frame_time_label.setText("Average Frame Time: " + QString::number(average_frame_time / 1e6, 'f', 3) + " ms");
+}
+
+void ControlPanel::update_frame_profile(const FrameProfiler::Results& results) {
+    cpu_record_time_label.setText("CPU Record: " + QString::number(results.cpu_record_time, 'f', 1) + " µs");
+    fence_wait_time_label.setText("Fence Wait: " + QString::number(results.fence_wait_time, 'f', 1) + " µs");
+    gpu_time_label.setText("GPU: " + QString::number(results.gpu_time, 'f', 1) + " µs");
+
+    QStringList scopes;
+    for (const auto& scope : results.scopes)
+        scopes << QString("  ") + scope.name + ": " + QString::number(scope.gpu_time, 'f', 1) + " µs";
+    gpu_scopes_label.setText(scopes.join('\n'));
+}
+
+void ControlPanel::update_memory_stats(const MemoryAllocator::Stats& stats) {
+    memory_allocations_label.setText(
+        "Allocations: " + QString::number(stats.allocation_count) +
+        " in " + QString::number(stats.device_memory_count) + " VkDeviceMemory" +
+        " (" + QString::number(stats.block_count) + " blocks, " + QString::number(stats.dedicated_count) + " dedicated)"
+    );
+    memory_usage_label.setText(
+        "Memory Used: " + QString::number(stats.used_bytes / 1024) + " KiB / " + QString::number(stats.reserved_bytes / 1024) + " KiB"
+    );
+    memory_fragmentation_label.setText(
+        "Fragmentation: " + QString::number(stats.internal_fragmentation()*100.0f, 'f', 1) + "% internal, " +
+        QString::number(stats.external_fragmentation()*100.0f, 'f', 1) + "% external"
+    );
+}
+
+void ControlPanel::update_startup_stats(qint64 startup_time, qint64 pipeline_creation_time, bool warm_pipeline_cache) {
+    startup_time_label.setText(
+        "Startup: " + QString::number(startup_time / 1e6, 'f', 1) + " ms" +
+        " (pipelines: " + QString::number(pipeline_creation_time / 1e6, 'f', 2) + " ms, " +
+        (warm_pipeline_cache ? "warm" : "cold") + " cache)"
+    );
+}
+
+void ControlPanel::update_mesh_stats(size_t triangle_count, const MeshOptimizer::VertexCacheStats& before, const MeshOptimizer::VertexCacheStats& after) {
+    mesh_stats_label.setText(
+        "Mesh: " + QString::number(triangle_count) + " triangles, ACMR " +
+        QString::number(before.acmr, 'f', 3) + " -> " + QString::number(after.acmr, 'f', 3) + ", VS invocations " +
+        QString::number(before.vs_invocations) + " -> " + QString::number(after.vs_invocations)
+    );
+}
+
+void ControlPanel::update_culling_stats(uint32_t nr_visible, uint32_t nr_objects, qint64 cull_time) {
+    culling_stats_label.setText(
+        "Culling: " + QString::number(nr_visible) + " / " + QString::number(nr_objects) + " visible (" +
+        QString::number(cull_time / 1e3, 'f', 1) + " µs)"
+    );
+}
+
+void ControlPanel::update_swap_chain_stats(const VulkanRenderTarget::SwapChainStats& stats) {
+    double average_rebuild_time = stats.nr_rebuilds == 0 ? 0.0 : stats.total_rebuild_time / stats.nr_rebuilds;
+    swap_chain_stats_label.setText(
+        "Swapchain: " + QString::number(stats.nr_rebuilds) + " rebuilds for " + QString::number(stats.nr_requests) +
+        " requests (last: " + QString::number(stats.last_rebuild_time / 1e3, 'f', 2) + " ms, average: " +
+        QString::number(average_rebuild_time / 1e3, 'f', 2) + " ms)"
+    );
+}
+
+void ControlPanel::set_pacing_settings(uint32_t nr_frames_in_flight, VkPresentModeKHR present_mode, uint32_t image_count) {
+    QSignalBlocker blocker(this);
+    frames_in_flight_box.setValue(nr_frames_in_flight);
+    present_mode_box.setCurrentIndex(present_mode_box.findData(int(present_mode)));
+    image_count_box.setValue(image_count);
+}
+
+void ControlPanel::update_pacing_stats(uint32_t nr_frames_in_flight, VkPresentModeKHR present_mode, uint32_t image_count,
+                                       double latency, qint64 frame_time) {
+    // No results yet (e.g. right after the number of frames in flight changed)
+    if (latency <= 0.0)
+        return;
+
+    PacingStats& stats = pacing_stats[{nr_frames_in_flight, present_mode, image_count}];
+    stats.nr_frames++;
+    stats.total_latency += latency;
+    stats.total_frame_time += frame_time;
 
-    average_frame_time_label.setText("Average Frame Time: " + QString::number(average_frame_time));
+    QStringList lines;
+    lines << "Latency & throughput per setting (frames in flight, present mode, images):";
+    for (const auto& [settings, setting_stats] : pacing_stats) {
+        double average_latency = setting_stats.total_latency / setting_stats.nr_frames;
+        double average_frame_time = double(setting_stats.total_frame_time) / setting_stats.nr_frames;
+        lines << QString("  ") + QString::number(std::get<0>(settings)) + ", " + present_mode_name(std::get<1>(settings)) + ", " +
+                 QString::number(std::get<2>(settings)) + ": " + QString::number(average_latency / 1e3, 'f', 2) + " ms latency, " +
+                 QString::number(1e9 / average_frame_time, 'f', 1) + " FPS (" + QString::number(setting_stats.nr_frames) + " frames)";
+    }
+    pacing_stats_label.setText(lines.join('\n'));
 }
\ No newline at end of file
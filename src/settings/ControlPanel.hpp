@@ -4,6 +4,16 @@
 #include <QWidget>
 #include <QLabel>
 #include <QGridLayout>
+#include <QSpinBox>
+#include <QComboBox>
+
+#include <map>
+#include <tuple>
+
+#include "MemoryAllocator.hpp"
+#include "FrameProfiler.hpp"
+#include "MeshOptimizer.hpp"
+#include "VulkanRenderTarget.hpp"
 
 class ControlPanel : public QWidget {
     Q_OBJECT;
@@ -11,7 +21,28 @@ class ControlPanel : public QWidget {
 public:
     ControlPanel(QWidget* parent=nullptr);
 
-    void update_frame_time(int ms);
+    // Wall-clock time between frames in ns
+    void update_frame_time(qint64 frame_time);
+    void update_frame_profile(const FrameProfiler::Results& results);
+    void update_memory_stats(const MemoryAllocator::Stats& stats);
+    // Times in ns
+    void update_startup_stats(qint64 startup_time, qint64 pipeline_creation_time, bool warm_pipeline_cache);
+    // Vertex cache stats before & after the mesh was optimized
+    void update_mesh_stats(size_t triangle_count, const MeshOptimizer::VertexCacheStats& before, const MeshOptimizer::VertexCacheStats& after);
+    // Time in ns
+    void update_culling_stats(uint32_t nr_visible, uint32_t nr_objects, qint64 cull_time);
+    void update_swap_chain_stats(const VulkanRenderTarget::SwapChainStats& stats);
+
+    // Shows the current frame pacing settings without emitting the signals below
+    void set_pacing_settings(uint32_t nr_frames_in_flight, VkPresentModeKHR present_mode, uint32_t image_count);
+    // Accumulates the latency & frame time of a frame under the settings in use (latency in µs, frame time in ns)
+    void update_pacing_stats(uint32_t nr_frames_in_flight, VkPresentModeKHR present_mode, uint32_t image_count,
+                             double latency, qint64 frame_time);
+
+signals:
+    void nr_frames_in_flight_changed(uint32_t nr_frames_in_flight);
+    void present_mode_changed(VkPresentModeKHR present_mode);
+    void image_count_changed(uint32_t image_count);
 
 private:
     QGridLayout* layout;
@@ -19,7 +50,38 @@ private:
     QLabel frame_time_label;
     QLabel average_frame_time_label;
     size_t current_frame_time_index = 0;
-    int frame_times[50] = {};
+    qint64 frame_times[50] = {};
+
+    QLabel cpu_record_time_label;
+    QLabel fence_wait_time_label;
+    QLabel gpu_time_label;
+    QLabel gpu_scopes_label;
+
+    QLabel memory_allocations_label;
+    QLabel memory_usage_label;
+    QLabel memory_fragmentation_label;
+
+    QLabel startup_time_label;
+
+    QLabel mesh_stats_label;
+    QLabel culling_stats_label;
+    QLabel swap_chain_stats_label;
+
+    QLabel frames_in_flight_title;
+    QSpinBox frames_in_flight_box;
+    QLabel present_mode_title;
+    QComboBox present_mode_box;
+    QLabel image_count_title;
+    QSpinBox image_count_box;
+
+    // Per combination of frames in flight, present mode & image count
+    struct PacingStats {
+        uint64_t nr_frames = 0;
+        double total_latency = 0.0; // µs
+        qint64 total_frame_time = 0; // ns
+    };
+    std::map<std::tuple<uint32_t, VkPresentModeKHR, uint32_t>, PacingStats> pacing_stats;
+    QLabel pacing_stats_label;
 };
 
 #endif
\ No newline at end of file
@@ -1,13 +1,17 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) out vec4 o_color;
 
 layout(location = 0) in vec3 v_color;
 layout(location = 1) in vec2 v_tex_coord;
+layout(location = 2) flat in uint v_texture_index;
 
-layout(set=0, binding=1) uniform sampler2D tex_sampler;
+// TextureTable: every texture, only the written slots may be used
+layout(set=1, binding=0) uniform sampler2D textures[];
 
 void main() {
-    o_color = texture(tex_sampler, v_tex_coord);
+    // Objects drawn by one instanced draw can use different textures
+    o_color = texture(textures[nonuniformEXT(v_texture_index)], v_tex_coord);
 }
@@ -4,19 +4,32 @@
 layout(location = 0) in vec3 a_position;
 layout(location = 1) in vec3 a_color;
 layout(location = 2) in vec2 a_tex_coord;
+// Per instance
+layout(location = 3) in mat4 a_instance_model;
+layout(location = 7) in uint a_material_index;
 
 layout(location = 0) out vec3 v_color;
 layout(location = 1) out vec2 v_tex_coord;
+layout(location = 2) flat out uint v_texture_index;
 
-layout(std140, set=0, binding=0) uniform MVP_UniformBufferObject {
+// Matches `max_materials` in VulkanRenderer.hpp
+const uint max_materials = 1024;
+
+layout(std140, set=0, binding=0) uniform FrameUniformBufferObject {
+    mat4 view_projection;
+    // Texture table slot of every material, 4 per element
+    uvec4 material_texture_slots[max_materials / 4];
+} frame_ubo;
+
+layout(push_constant) uniform DrawConstants {
     mat4 model;
-    mat4 view;
-    mat4 projection;
-} mvp_ubo;
+} draw;
 
 void main() {
-    vec4 position = mvp_ubo.projection*mvp_ubo.view*mvp_ubo.model * vec4(a_position, 1.0);
+    // Matrix-vector products only, the view projection is multiplied once per frame on the CPU
+    vec4 position = frame_ubo.view_projection * (a_instance_model * (draw.model * vec4(a_position, 1.0)));
     gl_Position = vec4(position.x, -position.y, position.zw);
     v_color = a_color;
     v_tex_coord = vec2(a_tex_coord.x, 1.0f-a_tex_coord.y);
+    v_texture_index = frame_ubo.material_texture_slots[a_material_index / 4][a_material_index % 4];
 }
\ No newline at end of file
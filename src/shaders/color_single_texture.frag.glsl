@@ -0,0 +1,14 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) out vec4 o_color;
+
+layout(location = 0) in vec3 v_color;
+layout(location = 1) in vec2 v_tex_coord;
+
+// TextureTable without descriptor indexing: only the last added texture
+layout(set=1, binding=0) uniform sampler2D texture_sampler;
+
+void main() {
+    o_color = texture(texture_sampler, v_tex_coord);
+}
@@ -1,3 +1,6 @@
 #!/bin/bash
 glslangValidator --target-env vulkan1.2 color.vert.glsl
-glslangValidator --target-env vulkan1.2 color.frag.glsl
\ No newline at end of file
+glslangValidator --target-env vulkan1.2 color.frag.glsl
+glslangValidator --target-env vulkan1.2 -S comp -o mip_downsample.spv mip_downsample.comp.glsl
+glslangValidator --target-env vulkan1.2 -S comp -o cull.spv cull.comp.glsl
+glslangValidator --target-env vulkan1.2 -S frag -o frag_single_texture.spv color_single_texture.frag.glsl
\ No newline at end of file
@@ -0,0 +1,53 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Tests every object's bounding sphere against the view frustum & appends a draw command for each visible one
+// The commands are consumed by vkCmdDrawIndexedIndirectCount, so their order doesn't matter
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+// Laid out like VkDrawIndexedIndirectCommand
+struct DrawCommand {
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+// xyz: center, w: radius
+layout(std430, set=0, binding=0) readonly buffer Bounds {
+    vec4 bounds[];
+};
+layout(std430, set=0, binding=1) writeonly buffer DrawCommands {
+    DrawCommand draw_commands[];
+};
+layout(std430, set=0, binding=2) buffer DrawCounts {
+    uint draw_counts[];
+};
+
+layout(push_constant) uniform CullParameters {
+    // xyz: inward normal, w: distance
+    vec4 planes[6];
+    uint nr_objects;
+    uint index_count;
+    // This frame's regions of the command & count buffers
+    uint first_command;
+    uint count_index;
+} parameters;
+
+void main() {
+    uint object = gl_GlobalInvocationID.x;
+    if (object >= parameters.nr_objects)
+        return;
+
+    vec4 sphere = bounds[object];
+    for (int i=0; i<6; i++) {
+        if (dot(parameters.planes[i].xyz, sphere.xyz) + parameters.planes[i].w < -sphere.w)
+            return;
+    }
+
+    uint slot = atomicAdd(draw_counts[parameters.count_index], 1);
+    // The instance index selects the object's instance data
+    draw_commands[parameters.first_command + slot] = DrawCommand(parameters.index_count, 1, 0, 0, object);
+}
\ No newline at end of file
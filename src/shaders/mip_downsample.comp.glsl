@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Writes one mip level from the previous one with a 2x2 box filter
+// For odd sizes the last row/column of the source is clamped, which slightly favours the edge texels
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+layout(set=0, binding=0) uniform sampler2DArray src_level;
+// Written without a format qualifier so one shader works for every storage format
+layout(set=0, binding=1) uniform writeonly image2DArray dst_level;
+
+void main() {
+    ivec3 dst = ivec3(gl_GlobalInvocationID);
+    ivec2 dst_size = imageSize(dst_level).xy;
+    if (dst.x >= dst_size.x || dst.y >= dst_size.y)
+        return;
+
+    ivec2 src_max = textureSize(src_level, 0).xy - 1;
+    ivec2 src = dst.xy * 2;
+    vec4 color = texelFetch(src_level, ivec3(min(src, src_max), dst.z), 0)
+               + texelFetch(src_level, ivec3(min(src + ivec2(1, 0), src_max), dst.z), 0)
+               + texelFetch(src_level, ivec3(min(src + ivec2(0, 1), src_max), dst.z), 0)
+               + texelFetch(src_level, ivec3(min(src + ivec2(1, 1), src_max), dst.z), 0);
+
+    imageStore(dst_level, dst, color * 0.25);
+}
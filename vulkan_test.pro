@@ -22,20 +22,58 @@ MOC_DIR = generated_files
 
 # Input
 HEADERS +=  src/VulkanFunctions.hpp \
+			src/VulkanRenderTarget.hpp \
 			src/VulkanWindow.hpp \
+			src/HeadlessRenderTarget.hpp \
 			src/VulkanRenderer.hpp \
 			src/Shader.hpp \
 			src/Image.hpp \
 			src/Buffer.hpp \
+			src/MemoryAllocator.hpp \
+			src/StagingRing.hpp \
+			src/Uploader.hpp \
+			src/PipelineCache.hpp \
+			src/MipGenerator.hpp \
+			src/Ktx2Texture.hpp \
+			src/TextureStreamer.hpp \
+			src/Mesh.hpp \
+			src/MeshOptimizer.hpp \
+			src/FrameProfiler.hpp \
+			src/FrustumCuller.hpp \
+			src/TransformHierarchy.hpp \
+			src/TextureTable.hpp \
+			src/DescriptorAllocator.hpp \
+			src/DescriptorCache.hpp \
+			src/UniformAllocator.hpp \
 			src/Vertex.hpp \
+			src/VertexLayout.hpp \
+			src/VertexQuantizer.hpp \
 			src/settings/ControlPanel.hpp
 
 SOURCES +=  src/main.cpp \
 			src/VulkanFunctions.cpp \
+			src/VulkanRenderTarget.cpp \
 			src/VulkanWindow.cpp \
+			src/HeadlessRenderTarget.cpp \
 			src/VulkanRenderer.cpp \
 			src/Shader.cpp \
 			src/Image.cpp \
 			src/Buffer.cpp \
-			src/Vertex.cpp \
+			src/MemoryAllocator.cpp \
+			src/StagingRing.cpp \
+			src/Uploader.cpp \
+			src/PipelineCache.cpp \
+			src/MipGenerator.cpp \
+			src/Ktx2Texture.cpp \
+			src/TextureStreamer.cpp \
+			src/Mesh.cpp \
+			src/MeshOptimizer.cpp \
+			src/FrameProfiler.cpp \
+			src/FrustumCuller.cpp \
+			src/TransformHierarchy.cpp \
+			src/TextureTable.cpp \
+			src/DescriptorAllocator.cpp \
+			src/DescriptorCache.cpp \
+			src/UniformAllocator.cpp \
+			src/VertexQuantizer.cpp \
 			src/settings/ControlPanel.cpp